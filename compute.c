@@ -26,60 +26,93 @@
 
 /*
 ================
-COM_ImpLThreshold
+COM_CosImpact
 
-decide if impact parameter below threshold
+cos of the largest angle at which a galaxy at angDiamD is still
+within the impact parameter threshold
 ================
 */
-int	COM_ImpLThreshold( catdata_t *cdn, catdata_t *cds, double threshold ) {
-	double delta;
-	double impact;
-	double dra;
-	double ddec;
-
-	dra = RAD*(cdn->ra - cds->ra);
-	ddec = RAD*(cdn->dec - cds->dec);
-	if (fabs(ddec)*cds->angDiamD > threshold)
-		return 0;
+double	COM_CosImpact( double angDiamD, double threshold ) {
+	double angle;
 
 	// comoving impact parameter = AngDiamDist * GreatCircDist
-	delta = MAT_GreatCircD( dra, ddec, cdn->cosdec, cds->cosdec );
-	impact = delta * cds->angDiamD;
+	if ( angDiamD <= 0 )
+		return -2.0;
+	angle = threshold / angDiamD;
+	if ( angle >= M_PI )
+		return -2.0;
 
-	if ( impact < threshold )
-		return 1;
-	else
-		return 0;
+	return cos( angle );
 }
 
-/*
-================
-COM_AngLThreshold
+typedef struct comjob_s {
+	catalog_t	*cat;
+	int		completed;
+	time_t		tic;
 
-decide if angular distance below threshold
-================
-*/
-int	COM_AngLThreshold( catdata_t *a, catdata_t *b,
-				double threshold, double *delta ) {
+	// ma and mn
+	kdtree_t	tree;
 
-	double result;
-	double dra;
-	double ddec;
+	// ma
+	double		threshold;
+	double		cosThreshold;
+	double		*mean, *delta, *num, *var;	// result columns
 
-	dra = a->ra - b->ra;
-	ddec = a->dec - b->dec;
+	// mn
+	int		nn_number;
+	double		*rm;
+	kdnn_t		**heap;			// per worker
+	sortNN_t	**neighbors;		// per worker
+	double		*meanNN, *deltaNN, *sdNN;	// result columns
+	double		*median, *medianDelta;
+} comjob_t;
 
-	if (fabs(ddec) > threshold)
-		return 0;
-
-	result = DEG*MAT_GreatCircD( RAD*dra, RAD*ddec, a->cosdec, b->cosdec );
+/*
+================
+COM_MeanRMChunk
 
-	if ( result < threshold ) {
-		*delta = result;
-		return 1;
+Worker job: mean RM of the sources at tree positions [start,end)
+================
+*/
+void	COM_MeanRMChunk( void *arg, int start, int end, int worker ) {
+	comjob_t	*job;
+	catalog_t	*cat;
+	int		t;
+
+	job = arg;
+	cat = job->cat;
+
+	for ( t=start; t<end; t++ ) {
+		int		i;
+		kdsum_t		near;
+		double		mean;
+
+		// other sources near, whole nodes inside the circle at once
+		i = job->tree.index[t];
+		KDT_DiscSum( &job->tree, job->tree.pos+3*t, job->cosThreshold,
+								t, &near );
+
+		// mean, no value without neighbours
+		job->num[i] = near.num;
+		if ( near.num < 1 ) {
+			job->mean[i] = job->delta[i] = job->var[i] = NAN;
+			continue;
+		}
+		mean = near.sum / near.num;
+		job->mean[i] = mean;
+		job->delta[i] = job->tree.value[t] - mean;
+
+		// variance, no value of a single neighbour
+		if ( near.num < 2 ) {
+			job->var[i] = NAN;
+			continue;
+		}
+		job->var[i] = (near.sum2 - near.sum*mean) / (near.num-1);
+		if ( job->var[i] < 0 )
+			job->var[i] = 0;
 	}
-	else
-		return 0;
+
+	THR_Progress( &job->completed, end-start, cat->number, job->tic );
 }
 
 /*
@@ -91,97 +124,114 @@ Compute mean RM
 */
 void	COM_MeanRM( const char *cmdLine ) {
 	double			threshold;
-	int			i;
 	catalog_t		*cat;
+	comjob_t		job;
+	thrjob_t		thrJob;
 
 	// Read parameters
 	if ( sscanf( cmdLine, "%lf", &threshold ) != 1 ) {
 		threshold	= 2.0;
 	}
+	if ( CUL_CullBusy() || STAT_DivideBusy() ) {
+		printf( "NVSS culling or division still running.\n" );
+		return;
+	}
+
 	printf( "Computing mean RM...\n" );
 	printf( "Threshold is %lf deg\n", threshold );
 
 	cat = nvss_culled;
-
-	for (i=0;i<cat->number;i++) {
-		int		k;
-		catdata_t	*a;
-		double		sum;
-		int		sourcesFound;
-
-		a = cat->data + i;
-		sum = 0.0;
-		sourcesFound = 0;
-
-		if ( i%2000 == 0 ) {
-			printf( "%i %%\n", (int)(100.0*i/cat->number) );
-		}
-		// find other sources near
-		for ( k=0; k<cat->number; k++ ) {
-			catdata_t	*b;
-			int		result;
-			double		delta;
-
-			// skip the galaxy itself
-			if ( k==i )
-				continue;
-			b = cat->data + k;
-			result = COM_AngLThreshold( a,b,threshold,&delta );
-
-			if ( result == 1 ) {
-				// found one nearby
-				sourcesFound++;
-				sum += b->rot_measure;
-			}
-		}
-		// mean
-		a->rot_measure_mean = sum / sourcesFound;
-		a->rot_measure_delta = a->rot_measure - a->rot_measure_mean;
-		a->sourcesNum = sourcesFound;
-	}
+	memset( &job, 0, sizeof(comjob_t) );
+	memset( &thrJob, 0, sizeof(thrjob_t) );
+	job.cat = cat;
+	job.threshold = threshold;
+	job.cosThreshold = cos( RAD*threshold );
+
+	// k-d tree over the sources, each node caching its RM sums
+	KDT_Build( &job.tree, cat );
+	KDT_Aggregate( &job.tree, MEM_Column( cat, CF_RM ) );
+	job.mean = MEM_Column( cat, CF_RMMEAN );
+	job.delta = MEM_Column( cat, CF_RMDELTA );
+	job.num = MEM_Column( cat, CF_SOURCESNUM );
+	job.var = MEM_Column( cat, CF_RMVAR );
+
+	time( &job.tic );
+	thrJob.func = COM_MeanRMChunk;
+	thrJob.arg = &job;
+	thrJob.number = cat->number;
+	THR_Run( &thrJob );
+
+	KDT_Free( &job.tree );
 	printf( "\nDone.\n" );
 }
 
 /*
 ================
-COM_SwapNN
+COM_MeanRMNNChunk
 
-swap Nearest Neighbors.
+Worker job: nearest neighbor mean RM of the sources [start,end)
 ================
 */
-void	COM_SwapNN( sortNN_t *a, sortNN_t *b ) {
-	sortNN_t tmp;
+void	COM_MeanRMNNChunk( void *arg, int start, int end, int worker ) {
+	comjob_t	*job;
+	catalog_t	*cat;
+	kdnn_t		*heap;
+	sortNN_t	*neighbors;
+	int		nn_number;
+	int		i;
+
+	job = arg;
+	cat = job->cat;
+	heap = job->heap[worker];
+	neighbors = job->neighbors[worker];
+	nn_number = job->nn_number;
+
+	for ( i=start; i<end; i++ ) {
+		int		k;
+		const catdata_t	*a;
+		double		sum, mean, median;
 
-	memcpy( &tmp,	a,	sizeof(sortNN_t) );
-	memcpy( a,	b,	sizeof(sortNN_t) );
-	memcpy( b,	&tmp,	sizeof(sortNN_t) );
-}
+		a = MEM_Row( cat, i );
+		sum = 0.0;
 
-/*
-================
-COM_SortNN
+		// the nn_number closest sources, sorted by distance
+		KDT_Nearest( &job->tree, a->vec, i, nn_number, heap );
 
-Sort Nearest Neighbors.
-Algorithm: Optimized Bubblesort
-================
-*/
-void	COM_SortNN( sortNN_t *neighbors, int num ) {
-	int k;
-
-	k = num;
-	do {
-		int i, l;
-
-		l = 1;
-		for (i=0; i<k-1; ++i) {
-			if (neighbors[i].dist > neighbors[i+1].dist) {
-				// swap
-				COM_SwapNN( neighbors+i, neighbors+i+1 );
-				l = i+1;
-			}
+		for ( k=0; k<nn_number; k++ ) {
+			// chord length to great circle distance in deg
+			neighbors[k].dist = DEG*MAT_ChordAngle( heap[k].dist2 );
+			neighbors[k].rot_measure = job->rm[heap[k].index];
+		}
+
+		// Get mean of them
+		for ( k=0; k<nn_number; k++ )
+			sum += neighbors[k].rot_measure;
+		mean = sum / nn_number;
+		job->meanNN[i] = mean;
+		job->deltaNN[i] = a->rot_measure-mean;
+
+		// median
+		if ( nn_number%2 == 1 )
+			median = neighbors[nn_number/2].rot_measure;
+		else
+			median = (neighbors[nn_number/2].rot_measure
+					+neighbors[(nn_number/2)-1].rot_measure)/2;
+		job->median[i] = median;
+		job->medianDelta[i] = a->rot_measure-median;
+
+		// standard deviation, no value of a single neighbour
+		if ( nn_number < 2 ) {
+			job->sdNN[i] = NAN;
+			continue;
 		}
-		k = l;
-	} while ( k > 1 );
+		sum = 0;
+		for ( k=0; k<nn_number; k++ )
+			sum += (neighbors[k].rot_measure-mean)
+				*(neighbors[k].rot_measure-mean);
+		job->sdNN[i] = sqrt( sum / (nn_number-1) );
+	}
+
+	THR_Progress( &job->completed, end-start, cat->number, job->tic );
 }
 
 /*
@@ -195,98 +245,64 @@ void	COM_MeanRM_NN( const char *cmdLine ) {
 	int			nn_number;
 	int			i;
 	catalog_t		*cat;
-	double			threshold;
-	sortNN_t		*neighbors;
-	int			sortSize;
+	comjob_t		job;
+	thrjob_t		thrJob;
+	int			numWorkers;
 
 	// Read parameters
 	if ( sscanf( cmdLine, "%i", &nn_number ) != 1 ) {
 		nn_number	= 20;
 	}
+	if ( CUL_CullBusy() || STAT_DivideBusy() ) {
+		printf( "NVSS culling or division still running.\n" );
+		return;
+	}
+
 	printf( "Computing mean RM nearest neighbor...\n" );
 	printf( "NN number is %i.\n", nn_number );
 
-	// we need enough array members to collect all nearby galaxies
-	sortSize = nn_number * 15;
-	neighbors = malloc( sortSize * sizeof(sortNN_t) );
 	cat = nvss_culled;
-	// search inside a radius about large enough to find enough
-	threshold = 1.5*sqrt( (double)nn_number );
-
-	for (i=0;i<cat->number;i++) {
-		int		k;
-		catdata_t	*a;
-		double		sum;
-		int		sourcesFound;
-
-		a = cat->data + i;
-		sum = 0.0;
-		sourcesFound = 0;
-
-		if ( i%2000 == 0 ) {
-			printf( "%i %%\n", (int)(100.0*i/cat->number) );
-		}
-		// collect all sources nearby
-		for ( k=0; k<cat->number; k++ ) {
-			catdata_t	*b;
-			int		result;
-			sortNN_t	*nn;
-			double		delta;
-
-			// skip the galaxy itself
-			if ( k==i )
-				continue;
-
-			b = cat->data + k;
-			result = COM_AngLThreshold( a,b,threshold,&delta );
-
-			if ( result == 1 ) {
-				// found one nearby
-				if ( sourcesFound == sortSize ) {
-					printf( "neighbor overrun.\n" );
-					free(neighbors);
-					return;
-				}
-				nn = neighbors + sourcesFound;
-				nn->dist = delta;
-				nn->rot_measure = b->rot_measure;
-				sourcesFound++;
-			}
-		}
-		// if found too little, error
-		if ( sourcesFound < nn_number ) {
-			printf("Not enough neighbors found in annulus. (%i).\n",
-					sourcesFound );
-			free( neighbors );
-			return;
-		}
-
-		// Sort them
-		COM_SortNN( neighbors, sourcesFound );
+	if ( nn_number < 1 || nn_number >= cat->number ) {
+		printf( "Not enough sources for %i neighbors (%i).\n",
+						nn_number, cat->number );
+		return;
+	}
 
-		// Get mean of them
-		for ( k=0; k<nn_number; k++ )
-			sum += neighbors[k].rot_measure;
-		a->rot_measure_mean_nn = sum / nn_number;
-		a->rot_measure_delta_nn = a->rot_measure-a->rot_measure_mean_nn;
+	memset( &job, 0, sizeof(comjob_t) );
+	memset( &thrJob, 0, sizeof(thrjob_t) );
+	job.cat = cat;
+	job.nn_number = nn_number;
+
+	// k-d tree over the unit vectors of all sources
+	KDT_Build( &job.tree, cat );
+	job.rm = MEM_Column( cat, CF_RM );
+	job.meanNN = MEM_Column( cat, CF_RMMEANNN );
+	job.deltaNN = MEM_Column( cat, CF_RMDELTANN );
+	job.sdNN = MEM_Column( cat, CF_RMSDNN );
+	job.median = MEM_Column( cat, CF_RMMEDIAN );
+	job.medianDelta = MEM_Column( cat, CF_RMMEDIANDELTA );
+
+	// scratch space of each worker
+	numWorkers = THR_NumWorkers( 0 );
+	job.heap = malloc( numWorkers * sizeof(kdnn_t*) );
+	job.neighbors = malloc( numWorkers * sizeof(sortNN_t*) );
+	for ( i=0; i<numWorkers; i++ ) {
+		job.heap[i] = malloc( nn_number * sizeof(kdnn_t) );
+		job.neighbors[i] = malloc( nn_number * sizeof(sortNN_t) );
+	}
 
-		// median
-		if ( nn_number%2 == 1 )
-			a->rot_measure_median = neighbors[nn_number/2].rot_measure;
-		else
-			a->rot_measure_median = (neighbors[nn_number/2].rot_measure
-						+neighbors[(nn_number/2)-1].rot_measure)/2;
-		a->rot_measure_median_delta = a->rot_measure-a->rot_measure_median;
+	time( &job.tic );
+	thrJob.func = COM_MeanRMNNChunk;
+	thrJob.arg = &job;
+	thrJob.number = cat->number;
+	THR_Run( &thrJob );
 
-		// standard deviation
-		sum = 0;
-		for ( k=0; k<nn_number; k++ )
-			sum += (neighbors[k].rot_measure-a->rot_measure_mean_nn)
-				*(neighbors[k].rot_measure-a->rot_measure_mean_nn);
-		a->rot_measure_sd_nn = sqrt( sum / (nn_number-1) );
+	for ( i=0; i<numWorkers; i++ ) {
+		free( job.heap[i] );
+		free( job.neighbors[i] );
 	}
-
-	free( neighbors );
+	free( job.heap );
+	free( job.neighbors );
+	KDT_Free( &job.tree );
 	printf( "\nDone.\n" );
 }
-
@@ -0,0 +1,778 @@
+/*
+* crossmatch.c - NVSS/SDSS cross-matching
+*
+* Copyright (C) 2012 Michael Rieder <mr@student.ethz.ch>
+*
+* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or (at
+* your option) any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+*
+* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*/
+
+#include <limits.h>
+
+#include "skyplot.h"
+
+typedef struct xmsort_s {
+	double	dec;
+	int	index;
+} xmsort_t;
+
+// entries [lo,hi) of the galaxies that may reach a source
+typedef struct xmrange_s {
+	const double	*x, *y, *z;	// unit vectors of the entries
+	const double	*cos;		// cosReach of the entries
+	const int	*gal;		// catalog index of the entries
+	int		lo, hi;
+} xmrange_t;
+
+/*
+================
+XM_CompareDec
+
+qsort callback: order by declination, then by catalog index
+================
+*/
+int	XM_CompareDec( const void *a, const void *b ) {
+	const xmsort_t *sa = a;
+	const xmsort_t *sb = b;
+
+	if ( sa->dec < sb->dec )
+		return -1;
+	if ( sa->dec > sb->dec )
+		return 1;
+	return sa->index - sb->index;
+}
+
+/*
+================
+XM_CompareDouble
+
+qsort callback for doubles
+================
+*/
+int	XM_CompareDouble( const void *a, const void *b ) {
+	double da = *(const double*)a;
+	double db = *(const double*)b;
+
+	return (da > db) - (da < db);
+}
+
+/*
+================
+XM_AngRadius
+
+largest angular distance (deg) at which a galaxy can still be within
+the impact parameter threshold
+================
+*/
+double	XM_AngRadius( double angDiamD, double threshold ) {
+	double r;
+
+	// no distance information: the galaxy matches everywhere
+	if ( angDiamD <= 0 )
+		return 180.0;
+
+	r = DEG*(threshold / angDiamD);
+	if ( r > 180.0 )
+		return 180.0;
+
+	return r + XM_RADIUS_PAD;
+}
+
+/*
+================
+XM_Reaches
+
+1 if the galaxy gal is within the impact parameter threshold of the
+unit vector vec, by the same dot product cut as the cross-match
+================
+*/
+int	XM_Reaches( const catdata_t *gal, const double *vec, double threshold ) {
+
+	return MAT_Dot( gal->vec, vec ) > COM_CosImpact( gal->angDiamD,
+								threshold );
+}
+
+/*
+================
+XM_BandOf
+
+declination band a declination falls into
+================
+*/
+int	XM_BandOf( const xmatch_t *xm, double dec ) {
+	int b;
+
+	b = (int)floor( (dec+90.0) / XM_BAND_WIDTH );
+	if ( b < 0 )
+		return 0;
+	if ( b >= xm->numBands )
+		return xm->numBands - 1;
+
+	return b;
+}
+
+/*
+================
+XM_BuildDiscIndex
+
+Rasterise the disc every galaxy can reach into sky pixels, so
+that a source only needs to check the galaxies listed for its
+pixel. Gives up (returns 0) if the discs cover too many pixels.
+================
+*/
+int	XM_BuildDiscIndex( xmatch_t *xm ) {
+	int		i;
+	double		*radius;
+	double		typical;
+	int		numEntries, maxEntries, size;
+	int		*entPix, *entGal;
+	int		*fill;
+	double		*sorted;
+	double		*x, *y, *z;
+	hpxlist_t	disc;
+
+	xm->pixOrder = -1;
+	if ( xm->number == 0 )
+		return 0;
+
+	radius = malloc( xm->number * sizeof(double) );
+	for ( i=0; i<xm->number; i++ )
+		radius[i] = RAD*XM_AngRadius( MEM_Row( xm->cat, i )->angDiamD,
+							xm->threshold );
+
+	// pixels about as large as the median disc
+	sorted = malloc( xm->number * sizeof(double) );
+	memcpy( sorted, radius, xm->number * sizeof(double) );
+	qsort( sorted, xm->number, sizeof(double), XM_CompareDouble );
+	typical = sorted[xm->number/2];
+	free( sorted );
+
+	if ( typical >= M_PI ) {
+		free( radius );
+		return 0;
+	}
+
+	xm->pixOrder = HPX_OrderForRadius( typical );
+	xm->numPix = HPX_NumPix( xm->pixOrder );
+
+	// collect (pixel, galaxy) pairs, galaxies in catalog order
+	if ( (long long)XM_MAX_DISCPIX * xm->number > INT_MAX )
+		maxEntries = INT_MAX;
+	else
+		maxEntries = XM_MAX_DISCPIX * xm->number;
+	numEntries = 0;
+	size = xm->number;
+	entPix = malloc( size * sizeof(int) );
+	entGal = malloc( size * sizeof(int) );
+	memset( &disc, 0, sizeof(hpxlist_t) );
+
+	for ( i=0; i<xm->number; i++ ) {
+		int		p;
+
+		HPX_QueryDisc( xm->pixOrder, MEM_Row( xm->cat, i )->vec, radius[i],
+								&disc );
+
+		if ( disc.num > maxEntries - numEntries ) {
+			// discs are too large for this to pay off
+			numEntries = -1;
+			break;
+		}
+		if ( numEntries + disc.num > size ) {
+			// grow geometrically, up to the budget
+			while ( numEntries + disc.num > size )
+				size = size > maxEntries/2 ? maxEntries : 2*size;
+			entPix = realloc( entPix, size * sizeof(int) );
+			entGal = realloc( entGal, size * sizeof(int) );
+		}
+		for ( p=0; p<disc.num; p++ ) {
+			entPix[numEntries] = disc.pix[p];
+			entGal[numEntries] = i;
+			numEntries++;
+		}
+	}
+	free( disc.pix );
+	free( radius );
+
+	if ( numEntries < 0 ) {
+		free( entPix );
+		free( entGal );
+		xm->pixOrder = -1;
+		return 0;
+	}
+
+	// counting sort by pixel
+	xm->pixStart = calloc( xm->numPix+1, sizeof(int) );
+	xm->pixGal = malloc( ((size_t)numEntries+1) * sizeof(int) );
+	for ( i=0; i<numEntries; i++ )
+		xm->pixStart[entPix[i]+1]++;
+	for ( i=0; i<xm->numPix; i++ )
+		xm->pixStart[i+1] += xm->pixStart[i];
+
+	fill = malloc( xm->numPix * sizeof(int) );
+	memcpy( fill, xm->pixStart, xm->numPix * sizeof(int) );
+	for ( i=0; i<numEntries; i++ )
+		xm->pixGal[fill[entPix[i]]++] = entGal[i];
+
+	// copy what the lookup reads next to each entry
+	x = MEM_Column( xm->cat, CF_VECX );
+	y = MEM_Column( xm->cat, CF_VECY );
+	z = MEM_Column( xm->cat, CF_VECZ );
+	xm->px = MEM_AllocAligned( ((size_t)numEntries+1) * sizeof(double) );
+	xm->py = MEM_AllocAligned( ((size_t)numEntries+1) * sizeof(double) );
+	xm->pz = MEM_AllocAligned( ((size_t)numEntries+1) * sizeof(double) );
+	xm->pcos = MEM_AllocAligned( ((size_t)numEntries+1) * sizeof(double) );
+	for ( i=0; i<numEntries; i++ ) {
+		int k = xm->pixGal[i];
+
+		xm->px[i] = x[k];
+		xm->py[i] = y[k];
+		xm->pz[i] = z[k];
+		xm->pcos[i] = xm->cosReach[k];
+	}
+
+	free( fill );
+	free( entPix );
+	free( entGal );
+
+	return 1;
+}
+
+/*
+================
+XM_Build
+
+Look the galaxies up by pixel if their discs are small enough,
+otherwise sort them by declination and find the largest reachable
+radius of each declination band
+================
+*/
+void	XM_Build( xmatch_t *xm, catalog_t *sdss, double threshold ) {
+	int		i;
+	xmsort_t	*sorted;
+	double		*x, *y, *z;
+
+	XM_Free( xm );
+
+	xm->cat = sdss;
+	xm->threshold = threshold;
+	xm->number = sdss->number;
+	xm->pixOrder = -1;
+	xm->angDiamD = MEM_Column( sdss, CF_ANGDIAMD );
+
+	// impact threshold as a dot product threshold per galaxy
+	xm->cosReach = malloc( (xm->number+1) * sizeof(double) );
+	for ( i=0; i<xm->number; i++ )
+		xm->cosReach[i] = COM_CosImpact( MEM_Row( sdss, i )->angDiamD,
+								threshold );
+
+	// small discs are best looked up by pixel
+	if ( XM_BuildDiscIndex( xm ) == 1 ) {
+		printf( "Cross-match: disc index at order %i, %i entries.\n",
+					xm->pixOrder, xm->pixStart[xm->numPix] );
+		return;
+	}
+
+	xm->numBands = (int)ceil( 180.0 / XM_BAND_WIDTH );
+	xm->maxRadius = 0;
+	xm->order = malloc( (xm->number+1) * sizeof(int) );
+	xm->dec = malloc( (xm->number+1) * sizeof(double) );
+	xm->bandStart = calloc( xm->numBands + 1, sizeof(int) );
+	xm->bandRadius = calloc( xm->numBands, sizeof(double) );
+	xm->sx = MEM_AllocAligned( (xm->number+1) * sizeof(double) );
+	xm->sy = MEM_AllocAligned( (xm->number+1) * sizeof(double) );
+	xm->sz = MEM_AllocAligned( (xm->number+1) * sizeof(double) );
+	xm->scos = MEM_AllocAligned( (xm->number+1) * sizeof(double) );
+
+	// sort galaxies by declination
+	sorted = malloc( (xm->number+1) * sizeof(xmsort_t) );
+	for ( i=0; i<xm->number; i++ ) {
+		sorted[i].dec = MEM_Row( sdss, i )->dec;
+		sorted[i].index = i;
+	}
+	qsort( sorted, xm->number, sizeof(xmsort_t), XM_CompareDec );
+
+	x = MEM_Column( sdss, CF_VECX );
+	y = MEM_Column( sdss, CF_VECY );
+	z = MEM_Column( sdss, CF_VECZ );
+	for ( i=0; i<xm->number; i++ ) {
+		int		b;
+		double		r;
+
+		xm->order[i] = sorted[i].index;
+		xm->dec[i] = sorted[i].dec;
+		xm->sx[i] = x[sorted[i].index];
+		xm->sy[i] = y[sorted[i].index];
+		xm->sz[i] = z[sorted[i].index];
+		xm->scos[i] = xm->cosReach[sorted[i].index];
+
+		// band bookkeeping
+		b = XM_BandOf( xm, sorted[i].dec );
+		xm->bandStart[b+1]++;
+		r = XM_AngRadius( MEM_Row( sdss, sorted[i].index )->angDiamD,
+								threshold );
+		if ( r > xm->bandRadius[b] )
+			xm->bandRadius[b] = r;
+		if ( r > xm->maxRadius )
+			xm->maxRadius = r;
+	}
+	free( sorted );
+
+	// band counts to offsets
+	for ( i=0; i<xm->numBands; i++ )
+		xm->bandStart[i+1] += xm->bandStart[i];
+
+	printf( "Cross-match: declination sweep.\n" );
+}
+
+/*
+================
+XM_LowerBound
+
+first sorted entry in [lo,hi) with dec >= value
+================
+*/
+int	XM_LowerBound( const double *dec, int lo, int hi, double value ) {
+
+	while ( lo < hi ) {
+		int mid = lo + (hi-lo)/2;
+
+		if ( dec[mid] < value )
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/*
+================
+XM_Candidates
+
+Next range of entries whose galaxies may reach cdn: the galaxies
+listed for its pixel, or the reachable window of one declination
+band. Start with *cursor = 0; returns 0 when no range is left.
+================
+*/
+int	XM_Candidates( const xmatch_t *xm, const catdata_t *cdn, int *cursor,
+							xmrange_t *range ) {
+	int b, blast;
+
+	if ( xm->number == 0 )
+		return 0;
+
+	if ( xm->pixOrder >= 0 ) {
+		int p;
+
+		if ( *cursor != 0 )
+			return 0;
+		*cursor = 1;
+
+		// galaxies whose disc may cover our pixel
+		p = HPX_Loc2Pix( xm->pixOrder, cdn->vec[2],
+						RAD*cdn->ra, cdn->cosdec );
+		range->x = xm->px;
+		range->y = xm->py;
+		range->z = xm->pz;
+		range->cos = xm->pcos;
+		range->gal = xm->pixGal;
+		range->lo = xm->pixStart[p];
+		range->hi = xm->pixStart[p+1];
+		return 1;
+	}
+
+	// only bands that can reach us at all, the cursor is the next one
+	if ( *cursor == 0 )
+		b = XM_BandOf( xm, cdn->dec - xm->maxRadius );
+	else
+		b = *cursor;
+	blast = XM_BandOf( xm, cdn->dec + xm->maxRadius );
+
+	for ( ; b<=blast; b++ ) {
+		int	lo, hi;
+		double	r;
+
+		if ( xm->bandStart[b] == xm->bandStart[b+1] )
+			continue;
+
+		// window inside the band this band's galaxies can reach
+		r = xm->bandRadius[b];
+		lo = XM_LowerBound( xm->dec, xm->bandStart[b],
+					xm->bandStart[b+1], cdn->dec - r );
+		hi = XM_LowerBound( xm->dec, lo,
+					xm->bandStart[b+1], cdn->dec + r );
+		if ( lo == hi )
+			continue;
+
+		*cursor = b+1;
+		range->x = xm->sx;
+		range->y = xm->sy;
+		range->z = xm->sz;
+		range->cos = xm->scos;
+		range->gal = xm->order;
+		range->lo = lo;
+		range->hi = hi;
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+================
+XM_FirstMatch
+
+catalog index of a galaxy whose impact parameter to cdn is below
+the threshold, or -1 if there is none
+================
+*/
+int	XM_FirstMatch( const xmatch_t *xm, const catdata_t *cdn ) {
+	xmrange_t	r;
+	int		cursor, e;
+
+	cursor = 0;
+	while ( XM_Candidates( xm, cdn, &cursor, &r ) ) {
+		e = MAT_FirstDotAbove( r.x, r.y, r.z, r.cos, r.lo, r.hi,
+								cdn->vec );
+		if ( e >= 0 )
+			return r.gal[e];
+	}
+
+	return -1;
+}
+
+/*
+================
+XM_Impact
+
+impact parameter of galaxy k at the entry x,y,z to a source
+================
+*/
+double	XM_Impact( const xmatch_t *xm, int k, double x, double y, double z,
+							const double *vec ) {
+	double dx, dy, dz;
+
+	// matches everywhere, like COM_CosImpact
+	if ( xm->angDiamD[k] <= 0 )
+		return 0;
+
+	dx = x - vec[0];
+	dy = y - vec[1];
+	dz = z - vec[2];
+	return xm->angDiamD[k] * MAT_ChordAngle( dx*dx + dy*dy + dz*dz );
+}
+
+/*
+================
+XM_Nearest
+
+catalog index of the galaxy with the smallest impact parameter to
+cdn among those below the threshold, or -1 if there is none. Ties
+go to the lower index.
+================
+*/
+int	XM_Nearest( const xmatch_t *xm, const catdata_t *cdn, double *impact ) {
+	xmrange_t	r;
+	int		cursor, e;
+	int		best;
+	double		bestImpact;
+
+	best = -1;
+	bestImpact = 0;
+	cursor = 0;
+	while ( XM_Candidates( xm, cdn, &cursor, &r ) ) {
+		for ( e=r.lo; e<r.hi; e++ ) {
+			int	k;
+			double	d;
+
+			if ( r.x[e]*cdn->vec[0] + r.y[e]*cdn->vec[1]
+				+ r.z[e]*cdn->vec[2] <= r.cos[e] )
+				continue;
+			k = r.gal[e];
+			d = XM_Impact( xm, k, r.x[e], r.y[e], r.z[e], cdn->vec );
+			if ( best < 0 || d < bestImpact
+				|| (d == bestImpact && k < best) ) {
+				best = k;
+				bestImpact = d;
+			}
+		}
+	}
+
+	*impact = bestImpact;
+	return best;
+}
+
+/*
+================
+XM_Pairs
+
+Every galaxy whose impact parameter to cdn is below the threshold,
+with that impact parameter. Only counts them if pairs is NULL.
+================
+*/
+int	XM_Pairs( const xmatch_t *xm, const catdata_t *cdn, xmpair_t *pairs ) {
+	xmrange_t	r;
+	int		cursor, e;
+	int		num;
+
+	num = 0;
+	cursor = 0;
+	while ( XM_Candidates( xm, cdn, &cursor, &r ) ) {
+		for ( e=r.lo; e<r.hi; e++ ) {
+			if ( r.x[e]*cdn->vec[0] + r.y[e]*cdn->vec[1]
+				+ r.z[e]*cdn->vec[2] <= r.cos[e] )
+				continue;
+			if ( pairs != NULL ) {
+				pairs[num].gal = r.gal[e];
+				pairs[num].impact = XM_Impact( xm, r.gal[e],
+					r.x[e], r.y[e], r.z[e], cdn->vec );
+			}
+			num++;
+		}
+	}
+
+	return num;
+}
+
+typedef struct xmjob_s {
+	xmatch_t	*xm;
+	catalog_t	*nvss;
+	catalog_t	*sdss;
+	const double	*z, *mass, *ubcolor;	// SDSS columns
+	double		*impact, *index;	// NVSS result columns
+	double		*nearZ, *nearMass, *nearUBColor;
+	int		completed;
+	time_t		tic;
+} xmjob_t;
+
+/*
+================
+XM_AnnotateChunk
+
+Worker job: nearest galaxy of the NVSS sources [start,end)
+================
+*/
+void	XM_AnnotateChunk( void *arg, int start, int end, int worker ) {
+	xmjob_t		*job;
+	int		i;
+
+	job = arg;
+	for ( i=start; i<end; i++ ) {
+		double	impact;
+		int	k;
+
+		k = XM_Nearest( job->xm, MEM_Row( job->nvss, i ), &impact );
+		if ( k < 0 ) {
+			job->impact[i] = 0;
+			job->index[i] = -1;
+			job->nearZ[i] = 0;
+			job->nearMass[i] = 0;
+			job->nearUBColor[i] = 0;
+			continue;
+		}
+		job->impact[i] = impact;
+		job->index[i] = MEM_RowIndex( job->sdss, k );
+		job->nearZ[i] = job->z[k];
+		job->nearMass[i] = job->mass[k];
+		job->nearUBColor[i] = job->ubcolor[k];
+	}
+
+	THR_Progress( &job->completed, end-start, job->nvss->number,
+								job->tic );
+}
+
+/*
+================
+XM_NearCovers
+
+1 if the near_* results of nvss answer every impact test against
+the current rows of sdss at threshold
+================
+*/
+int	XM_NearCovers( const catalog_t *nvss, const catalog_t *sdss,
+							double threshold ) {
+
+	return nvss->near.radius > 0 && threshold <= nvss->near.radius
+		&& nvss->near.sdss == sdss && nvss->near.serial == sdss->serial;
+}
+
+/*
+================
+XM_NearRow
+
+row of the nearest galaxy of NVSS source i, NULL if it has none
+================
+*/
+const catdata_t*	XM_NearRow( const catalog_t *nvss, const double *index,
+									int i ) {
+	const catalog_t *sdss;
+
+	if ( index[i] < 0 )
+		return NULL;
+	sdss = nvss->near.sdss;
+	if ( sdss->base != NULL )
+		sdss = sdss->base;
+	return sdss->data + (int)index[i];
+}
+
+/*
+================
+XM_NearMarks
+
+Sort the NVSS sources by their nearest galaxy instead of a
+cross-match, see XM_NearCovers
+================
+*/
+void	XM_NearMarks( catalog_t *nvss, double threshold, unsigned char *mark ) {
+	double	*index;
+	int	i;
+
+	index = MEM_Column( nvss, CF_NEARINDEX );
+	for ( i=0; i<nvss->number; i++ ) {
+		const catdata_t *gal = XM_NearRow( nvss, index, i );
+
+		if ( gal != NULL && XM_Reaches( gal, MEM_Row( nvss, i )->vec,
+								threshold ) )
+			mark[i] = THR_MARK_HIT;
+		else
+			mark[i] = THR_MARK_MISS;
+	}
+}
+
+/*
+================
+XM_NearestColumns
+
+Fill the near_* results of nvss against sdss up to radius on the
+thread pool. Returns the number of sources with a galaxy.
+================
+*/
+int	XM_NearestColumns( catalog_t *nvss, catalog_t *sdss, double radius ) {
+	xmatch_t	xm;
+	xmjob_t		job;
+	thrjob_t	thrJob;
+	int		i, found;
+
+	memset( &xm, 0, sizeof(xmatch_t) );
+	XM_Build( &xm, sdss, radius );
+
+	memset( &job, 0, sizeof(xmjob_t) );
+	job.xm = &xm;
+	job.nvss = nvss;
+	job.sdss = sdss;
+	job.z = MEM_Column( sdss, CF_Z );
+	job.mass = MEM_Column( sdss, CF_MASS );
+	job.ubcolor = MEM_Column( sdss, CF_UBCOLOR );
+	job.impact = MEM_Column( nvss, CF_NEARIMPACT );
+	job.index = MEM_Column( nvss, CF_NEARINDEX );
+	job.nearZ = MEM_Column( nvss, CF_NEARZ );
+	job.nearMass = MEM_Column( nvss, CF_NEARMASS );
+	job.nearUBColor = MEM_Column( nvss, CF_NEARUBCOLOR );
+	time( &job.tic );
+
+	memset( &thrJob, 0, sizeof(thrjob_t) );
+	thrJob.func = XM_AnnotateChunk;
+	thrJob.arg = &job;
+	thrJob.number = nvss->number;
+	THR_Run( &thrJob );
+	printf( "\n" );
+	XM_Free( &xm );
+
+	nvss->near.radius = radius;
+	nvss->near.sdss = sdss;
+	nvss->near.serial = sdss->serial;
+
+	found = 0;
+	for ( i=0; i<nvss->number; i++ )
+		found += job.index[i] >= 0;
+
+	return found;
+}
+
+/*
+================
+XM_Annotate
+
+Nearest galaxy by impact parameter of every culled NVSS source, up
+to a radius: 'a<s|a> [radius]' against the culled SDSS or SDSS A.
+cn or dn at a threshold up to the radius then read it instead of
+cross-matching again.
+================
+*/
+void	XM_Annotate( const char *cmdLine ) {
+	catalog_t	*sdss, *nvss;
+	double		radius;
+	int		found;
+
+	switch ( cmdLine[0] ) {
+		case 's':
+		sdss = sdss_culled;
+		break;
+		case 'a':
+		sdss = &sdss_A;
+		break;
+		default:
+		printf( "Unknown SDSS set '%c'.\n", cmdLine[0] );
+		return;
+	}
+	radius = XM_DEFAULT_NEAR;
+	sscanf( cmdLine+1, "%lf", &radius );
+	if ( radius <= 0 ) {
+		printf( "Radius must be positive.\n" );
+		return;
+	}
+	if ( CUL_CullBusy() || STAT_DivideBusy() ) {
+		printf( "NVSS culling or division still running.\n" );
+		return;
+	}
+
+	nvss = nvss_culled;
+	printf( "Nearest galaxy of %i NVSS sources among %i SDSS "
+			"up to %lf Kiloparsecs...\n", nvss->number,
+			sdss->number, radius );
+
+	found = XM_NearestColumns( nvss, sdss, radius );
+	printf( "%i sources have a galaxy within %lf Kiloparsecs.\n",
+							found, radius );
+}
+
+/*
+================
+XM_Free
+
+Free the cross-match index
+================
+*/
+void	XM_Free( xmatch_t *xm ) {
+
+	free( xm->order );
+	free( xm->dec );
+	free( xm->bandStart );
+	free( xm->bandRadius );
+	free( xm->cosReach );
+	free( xm->sx );
+	free( xm->sy );
+	free( xm->sz );
+	free( xm->scos );
+	free( xm->pixStart );
+	free( xm->pixGal );
+	free( xm->px );
+	free( xm->py );
+	free( xm->pz );
+	free( xm->pcos );
+	memset( xm, 0, sizeof(xmatch_t) );
+}
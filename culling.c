@@ -30,12 +30,10 @@
 * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 */
 
-pthread_mutex_t	cull_mutex = PTHREAD_MUTEX_INITIALIZER;
 int		cull_completed;
-int		numCulThreads = -1;
-int		culThreadsFin = 0;
-pthread_t	*cpThreads;
-threadData_t	*cThreadData;
+thrjob_t	cullJob;
+threadData_t	cullData;
+xmatch_t	cullMatch;
 
 
 /*
@@ -51,6 +49,7 @@ void	CUL_CullbyCrit( cattype_t cType, const char *buf ) {
 	double a, b;
 	catalog_t *old;
 	catalog_t *new;
+	double *col;
 
 	switch ( cType ) {
 		default:
@@ -68,44 +67,49 @@ void	CUL_CullbyCrit( cattype_t cType, const char *buf ) {
 		break;
 	}
 
-	new->number = 0;
+	MEM_ClearCat( new );
 
 	switch (type) {
 		case 'c':
+		col = MEM_Column( old, CF_RMMEAN );
 		for ( i=0; i<old->number; i++ ) {
-			if ( fabs((old->data+i)->rot_measure_mean) <= a ) {
+			if ( fabs(col[i]) <= a ) {
 
 				MEM_AppendCat( old, new, i );
 			}
 		}
 		break;
 		case 'n':
+		col = MEM_Column( old, CF_RMMEANNN );
 		for ( i=0; i<old->number; i++ ) {
-			if ( fabs((old->data+i)->rot_measure_mean_nn) <= a ) {
+			if ( fabs(col[i]) <= a ) {
 
 				MEM_AppendCat( old, new, i );
 			}
 		}
 		break;
 		case 'l':
+		col = MEM_Column( old, CF_LATITUDE );
 		for ( i=0; i<old->number; i++ ) {
-			if ( fabs((old->data+i)->latitude) >= a ) {
+			if ( fabs(col[i]) >= a ) {
 
 				MEM_AppendCat( old, new, i );
 			}
 		}
 		break;
 		case 'd':
+		col = MEM_Column( old, CF_DEC );
 		for ( i=0; i<old->number; i++ ) {
-			if ( (old->data+i)->dec >= a && (old->data+i)->dec <= b) {
+			if ( col[i] >= a && col[i] <= b) {
 
 				MEM_AppendCat( old, new, i );
 			}
 		}
 		break;
 		case 'z':
+		col = MEM_Column( old, CF_Z );
 		for ( i=0; i<old->number; i++ ) {
-			if ( (old->data+i)->z >= a && (old->data+i)->z <= b) {
+			if ( col[i] >= a && col[i] <= b) {
 
 				MEM_AppendCat( old, new, i );
 			}
@@ -116,6 +120,9 @@ void	CUL_CullbyCrit( cattype_t cType, const char *buf ) {
 		MEM_SwitchSDSSBuffer();
 		return;
 	}
+	if ( cType == CT_NVSS )
+		// nearest galaxies follow the rows
+		new->near = old->near;
 	if (cType==CT_SDSS)
 		printf( "Culled SDSS by %c from %lf to %lf (%i sources)\n",
 						type, a, b, new->number );
@@ -129,24 +136,23 @@ void	CUL_CullbyCrit( cattype_t cType, const char *buf ) {
 ================
 CUL_ThreadFinished
 
-Worker thread finished
+Last worker finished
 ================
 */
-void	CUL_ThreadFinished( void ) {
+void	CUL_ThreadFinished( void *arg ) {
+	threadData_t	*threadData;
 
-	pthread_mutex_lock( &cull_mutex );
-	culThreadsFin++;
-	pthread_mutex_unlock( &cull_mutex );
+	threadData = arg;
 
-	if ( culThreadsFin < numCulThreads + 1 )
-		return;
+	// no thread uses the cross-match index anymore
+	XM_Free( &cullMatch );
 
-	// worker threads finished
-	if ( scripted == 0 ) {
-		// free only in interactive mode here
-		free( cpThreads );
-		free( cThreadData );
-	}
+	// collect the hits in catalog order
+	MEM_GatherCat( threadData->from, threadData->toA,
+					threadData->mark, THR_MARK_HIT );
+	threadData->toA->near = threadData->from->near;
+	free( threadData->mark );
+	threadData->mark = NULL;
 
 	printf( "Got %i sources after culling.\n", nvss_culled->number );
 
@@ -156,105 +162,63 @@ void	CUL_ThreadFinished( void ) {
 
 /*
 ================
-CUL_CullThread
+CUL_CullChunk
 
-Worker thread for culling NVSS
+Worker job: cull the NVSS sources [start,end)
 ================
 */
-void*	CUL_CullThread( void *arg ) {
+void	CUL_CullChunk( void *arg, int start, int end, int worker ) {
 	threadData_t	*threadData;
-	int		i, k, j;
-	catalog_t	*from, *to;
-	catalog_t	*sdss;
-	time_t		toc;
-	int		start;
-	int		end;
-	double		threshold;
-	time_t		tic;
-
-	// thread may be canceled any time
-	pthread_setcanceltype( PTHREAD_CANCEL_ASYNCHRONOUS, &i );
+	int		i;
+	catalog_t	*from;
 
 	// get our worker info
 	threadData = arg;
 
-	sdss = sdss_culled;
 	from = threadData->from;
-	to = threadData->toA;
-	start = threadData->start;
-	end = threadData->end;
-	threshold = threadData->threshold;
-	tic = threadData->tic;
-
-	j = 0;
 
-	// iterate
+	// iterate, every source is ours alone
 	for ( i=start; i<end; i++ ){
-		catdata_t	*cdn;
-
-		// print out info how far we got
-		if ( i%500 == 0 ) {
-			double difft;
-
-			pthread_mutex_lock( &cull_mutex );
-			cull_completed += i - start;
-			cull_completed -= j;
-			j = i - start;
-			pthread_mutex_unlock( &cull_mutex );
-
-			time( &toc );
-
-			difft = difftime(toc,tic);
-			printf( "%i%% time: %.1lf / %.1lf minutes\n",
-					100 * cull_completed / from->number,
-					difft/60,
-					difft*from->number/cull_completed/60 );
-		}
-
-		cdn = from->data + i;
-		// calculate distance to nearest SDSS
-		for ( k=0; k<sdss->number; k++ ) {
-			catdata_t *cds;
-			int result;
-
-			cds = sdss->data + k;
-			result = COM_ImpLThreshold( cdn,cds,threshold );
-
-			if ( result == 1 ) {
-				// found one nearby
-				pthread_mutex_lock( &cull_mutex );
-				MEM_AppendCat( from, to, i );
-				pthread_mutex_unlock( &cull_mutex );
-				break;
-			}
-		}
+		const catdata_t	*cdn;
+
+		cdn = MEM_Row( from, i );
+		// look for an SDSS galaxy within reach
+		if ( XM_FirstMatch( &cullMatch, cdn ) >= 0 )
+			threadData->mark[i] = THR_MARK_HIT;
+		else
+			threadData->mark[i] = THR_MARK_MISS;
 	}
 
-	// Thread finished.
-	CUL_ThreadFinished();
-
-	return NULL;
+	THR_Progress( &cull_completed, end-start, from->number, threadData->tic );
 }
 
 /*
 ================
 CUL_CullNVSS
 
-Start threads to cull the NVSS
+Hand the NVSS culling to the thread pool
 ================
 */
 void	CUL_CullNVSS( const char *cmdLine ) {
 	double			threshold;
-	int			i;
+	int			numThreads;
+	int			n;
 	catalog_t		*from;
 	catalog_t		*to;
 
-	// Read culling parameters
-	if ( sscanf( cmdLine, "%lf %i", &threshold, &numCulThreads ) != 2 ) {
-		threshold	= 1000.0;
-		numCulThreads	= 2;
+	if ( THR_Busy( &cullJob ) ) {
+		printf( "NVSS culling still running.\n" );
+		return;
 	}
-	printf( "Culling NVSS data (%i threads)...\n", numCulThreads );
+
+	// Read culling parameters, all workers by default
+	n = sscanf( cmdLine, "%lf %i", &threshold, &numThreads );
+	if ( n < 1 )
+		threshold	= 1000.0;
+	if ( n < 2 )
+		numThreads	= 0;
+	numThreads = THR_NumWorkers( numThreads );
+	printf( "Culling NVSS data (%i threads)...\n", numThreads );
 	printf( "Threshold is %lf Kiloparsecs\n", threshold );
 
 	from = nvss_culled;
@@ -262,44 +226,40 @@ void	CUL_CullNVSS( const char *cmdLine ) {
 	to = nvss_culled;
 
 	to->threshold = threshold;
-	to->number = 0;
+	MEM_ClearCat( to );
 	cull_completed = 0;
 
-	culThreadsFin = 0;
-
-	// allocate memory for thread management
-	cpThreads	= malloc( (numCulThreads+1) * sizeof(pthread_t) );
-	cThreadData	= malloc( (numCulThreads+1) * sizeof(threadData_t) );
-
-	// distribute the computation work among first n workers
-	for ( i=0; i<numCulThreads; i++ ){
-		(cThreadData+i)->start = i*(from->number/numCulThreads);
-		(cThreadData+i)->end = (i+1)*(from->number/numCulThreads);
-		(cThreadData+i)->threshold = threshold;
-		(cThreadData+i)->from = from;
-		(cThreadData+i)->toA = to;
+	cullData.from = from;
+	cullData.toA = to;
+	cullData.threshold = threshold;
+	cullData.mark = calloc( from->number+1, 1 );
+	// add a timestamp to measure working time
+	time( &cullData.tic );
+
+	// the nearest galaxies already tell
+	if ( XM_NearCovers( from, sdss_culled, threshold ) ) {
+		printf( "Using nearest galaxies up to %lf Kiloparsecs.\n",
+							from->near.radius );
+		XM_NearMarks( from, threshold, cullData.mark );
+		CUL_ThreadFinished( &cullData );
+		return;
+	}
+	// or a join with the pair table
+	if ( PAIR_Marks( from, sdss_culled, threshold, cullData.mark ) ) {
+		CUL_ThreadFinished( &cullData );
+		return;
 	}
-	// last worker gets the remainder
-	(cThreadData+numCulThreads)->start = from->number-(from->number%numCulThreads);
-	(cThreadData+numCulThreads)->end = from->number;
-	(cThreadData+numCulThreads)->threshold = threshold;
-	(cThreadData+numCulThreads)->from = from;
-	(cThreadData+numCulThreads)->toA = to;
-
-	// let the workers begin
-	for ( i=0; i<=numCulThreads; i++ ){
-		int err;
-
-		// add a timestamp to measure working time
-		time(&(cThreadData+i)->tic);
 
-		err = pthread_create(cpThreads+i,NULL,
-					CUL_CullThread,cThreadData+i);
+	// sort the SDSS by declination once for all workers
+	XM_Build( &cullMatch, sdss_culled, threshold );
 
-		if ( err != 0 )
-			printf( "Error creating thread %i of %i.\n",
-					i, numCulThreads );
-	}
+	// let the workers begin
+	cullJob.func = CUL_CullChunk;
+	cullJob.finish = CUL_ThreadFinished;
+	cullJob.arg = &cullData;
+	cullJob.number = from->number;
+	cullJob.maxWorkers = numThreads;
+	THR_Submit( &cullJob );
 }
 
 /*
@@ -310,44 +270,28 @@ Stop NVSS culling
 ================
 */
 void	CUL_CancelNVSS( void ) {
-	int i;
 
-	if ( culThreadsFin == numCulThreads + 1 ) {
+	if ( THR_Busy( &cullJob ) == 0 ) {
 		printf( "Threads already finished.\n" );
 		return;
 	}
 
 	printf( "Stopping threads...\n" );
-	for ( i=0; i<numCulThreads; i++ ){
-		int err;
-
-		err = pthread_cancel( *(cpThreads+i) );
-		if ( err != 0 )
-			printf( "Error stopping thread %i of %i.\n",
-					i+1, numCulThreads );
-	}
-	// wait for the last thread
-	pthread_join( *(cpThreads+numCulThreads), NULL );
+	THR_Cancel( &cullJob );
 
 	printf( "done.\n" );
 }
 
 /*
 ================
-CUL_WaitForThreads
+CUL_CullBusy
 
-Wait for the culling threads to finish
+1 while the NVSS culling is running
 ================
 */
-void	CUL_WaitForThreads( void ) {
-	int i;
+int	CUL_CullBusy( void ) {
 
-	// wait for all threads to finish
-	for ( i=0; i<numCulThreads+1; i++ ){
-		if ( pthread_join( *(cpThreads+i), NULL ) != 0 )
-			printf( "Error joining thread %i of %i.\n",
-							i, numCulThreads );
-	}
+	return THR_Busy( &cullJob );
 }
 
 /*
@@ -374,11 +318,8 @@ int	CUL_CullCancel( const char *cmdLine ) {
 			if ( scripted == 0 )
 				// no separating line...
 				return 1;
-			else {
-				CUL_WaitForThreads();
-				free( cpThreads );
-				free( cThreadData );
-			}
+			else
+				THR_Wait( &cullJob );
 		}
 		else CUL_CullbyCrit( CT_NVSS, cmdLine+1 );
 	}
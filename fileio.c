@@ -22,141 +22,649 @@
 * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 */
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#if defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+
 #include "skyplot.h"
 
 FILE	*script_file;
 
+// newline aligned piece of a mapped text file
+typedef struct fiochunk_s {
+	int		file;		// FIO_SDSS or FIO_COMOVD
+	const char	*start;
+	const char	*end;
+	int		first;		// record number of the first line
+	int		count;		// records in the chunk
+	int		error;		// 1-based line of a parse error
+} fiochunk_t;
+
+enum {
+	FIO_SDSS,
+	FIO_COMOVD
+};
+
+typedef struct fioload_s {
+	catalog_t	*cat;
+	fiochunk_t	*chunks;
+	const char	*text;		// NVSS records
+	unsigned char	*bad;		// NVSS records that did not parse
+} fioload_t;
+
+// exact powers of ten for the fast path of FIO_ParseDouble
+const double	fioPow10[23] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
 /*
 ================
-FIO_OpenDataFile
+FIO_ParseDouble
 
-Open file handle and count number of lines
+Locale independent number parser. Skips blanks, stops at the end of
+the line. Returns 0 if there is no number.
 ================
 */
-int	FIO_OpenDataFile( FILE **fp, const char *fs, catalog_t *cat ) {
-	int c;
-	int lines;
+int	FIO_ParseDouble( const char **cur, const char *end, double *out ) {
+	const char		*p, *token;
+	unsigned long long	mant;
+	int			digits, exp10, neg;
 
-	// Open File
-	*fp = fopen( fs, "rt" );
+	p = *cur;
+	while ( p < end && (*p == ' ' || *p == '\t' || *p == '\r') )
+		p++;
+	token = p;
 
-	if ( *fp == NULL ) {
-		printf( "File \"%s\" could not be opened.\n", fs );
-		cat->number = 0;
+	neg = 0;
+	if ( p < end && (*p == '-' || *p == '+') ) {
+		neg = *p == '-';
+		p++;
+	}
+
+	mant = 0;
+	digits = 0;
+	exp10 = 0;
+	for ( ; p < end && *p >= '0' && *p <= '9'; p++ ) {
+		if ( mant < 1000000000000000000ULL )
+			mant = 10*mant + (*p - '0');
+		else
+			exp10++;
+		digits++;
+	}
+	if ( p < end && *p == '.' ) {
+		for ( p++; p < end && *p >= '0' && *p <= '9'; p++ ) {
+			if ( mant < 1000000000000000000ULL ) {
+				mant = 10*mant + (*p - '0');
+				exp10--;
+			}
+			digits++;
+		}
+	}
+	if ( digits == 0 )
 		return 0;
+
+	if ( p < end && (*p == 'e' || *p == 'E') ) {
+		const char	*q;
+		int		eneg, e;
+
+		q = p+1;
+		eneg = 0;
+		if ( q < end && (*q == '-' || *q == '+') ) {
+			eneg = *q == '-';
+			q++;
+		}
+		if ( q < end && *q >= '0' && *q <= '9' ) {
+			for ( e=0; q < end && *q >= '0' && *q <= '9'; q++ )
+				if ( e < 10000 )
+					e = 10*e + (*q - '0');
+			exp10 += eneg ? -e : e;
+			p = q;
+		}
 	}
-	// Go to Start of File
-	rewind( *fp );
-	printf( "File \"%s\" opened.\n", fs );
 
-	// Count number of input lines
-	lines = 0;
-	do {
-		c = fgetc( *fp );
-		if (c == '\n') lines++;
-	} while (c != EOF);
+	if ( mant <= (1ULL << 53) && exp10 >= -22 && exp10 <= 22 ) {
+		// both operands exact: one correctly rounded operation
+		if ( exp10 < 0 )
+			*out = (double)mant / fioPow10[-exp10];
+		else
+			*out = (double)mant * fioPow10[exp10];
+		if ( neg )
+			*out = -*out;
+	}
+	else {
+		// rare long mantissas and big exponents
+		char	buf[64];
+		int	len;
 
-	if ( cat  != NULL )
-		cat->number = lines;
+		len = p - token;
+		if ( len >= (int)sizeof(buf) )
+			len = sizeof(buf) - 1;
+		memcpy( buf, token, len );
+		buf[len] = 0;
+		*out = strtod( buf, NULL );
+	}
 
-	return lines;
+	*cur = p;
+	return 1;
 }
 
 /*
 ================
-FIO_ReadDistFile
+FIO_MapText
 
-read ASCII distances
+Map a text file read-only, NULL if it is missing or empty
 ================
 */
-void	FIO_ReadDistFile( FILE *fp, catalog_t *cat ) {
-	int i;
-	double cD;
-	catdata_t *current;
+const char*	FIO_MapText( const char *name, size_t *size ) {
+	int		fd;
+	struct stat	st;
+	void		*map;
 
-	rewind( fp );
-	for ( i=0; i<cat->number; i++ ) {
-		current = cat->data + i;
+	fd = open( name, O_RDONLY );
+	if ( fd < 0 ) {
+		printf( "File \"%s\" could not be opened.\n", name );
+		return NULL;
+	}
+	if ( fstat( fd, &st ) != 0 || st.st_size == 0 ) {
+		close( fd );
+		return NULL;
+	}
+
+	map = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd );
+	if ( map == MAP_FAILED ) {
+		printf( "File \"%s\" could not be mapped.\n", name );
+		return NULL;
+	}
+	madvise( map, st.st_size, MADV_SEQUENTIAL );
+	printf( "File \"%s\" opened.\n", name );
+
+	*size = st.st_size;
+	return map;
+}
+
+/*
+================
+FIO_SplitText
+
+Cut a mapped text into about num newline aligned chunks.
+Returns the number of chunks written.
+================
+*/
+int	FIO_SplitText( const char *text, size_t size, int file, int num,
+							fiochunk_t *chunks ) {
+	const char	*p, *end;
+	int		n;
 
-		if (fscanf( fp, "%lf", &cD ) != 1)
-			printf( "comovD read fail.\n" );
+	p = text;
+	end = text + size;
+	for ( n=0; n<num && p<end; n++ ) {
+		const char *cut;
+
+		cut = text + (size_t)((double)size * (n+1) / num);
+		if ( cut < p )
+			cut = p;
+		if ( n == num-1 || cut >= end )
+			cut = end;
 		else {
-			// TODO: calculate list in Kiloparsec
-			cD *= 1000; // from GPc to MPc
-			cD *= 1000; // from Mpc to Kpc
-			current->comovD = cD;
-			current->angDiamD = MAT_AngDiamD(current->z,cD);
+			// move the cut behind the next newline
+			cut = memchr( cut, '\n', end - cut );
+			cut = cut ? cut + 1 : end;
 		}
+
+		memset( chunks+n, 0, sizeof(fiochunk_t) );
+		chunks[n].file = file;
+		chunks[n].start = p;
+		chunks[n].end = cut;
+		p = cut;
 	}
+	return n;
 }
 
 /*
 ================
-FIO_ReadCatFile
+FIO_NextLine
 
-read catalog ASCII data file
+Find the next line with any content in [*p,end). Returns 0 if there
+is none, else sets *p to the line and *eol to its end.
 ================
 */
-int	FIO_ReadCatFile( FILE *fp, catalog_t *cat ) {
-	int i;
-	catdata_t *current;
-
-	rewind(fp);
-	switch (cat->type ) {
-		char linebuffer[NVSS_LINE_LEN];
-
-		case CT_SDSS:
-		for ( i=0; i<cat->number; i++ ) {
-			current = cat->data + i;
-
-			if (fscanf( fp, "%lf %lf %lf %lf %lf %lf",&current->ra,
-						&current->dec,
-						&current->z,
-						&current->abs_petro_r_mag,
-						&current->u_b_color,
-						&current->stellar_mass ) !=6 )
-				{
-					printf("error reading SDSS data, line %i.\n",
-									i);
-					return 0;
-				}
+int	FIO_NextLine( const char **p, const char *end, const char **eol ) {
+
+	while ( *p < end ) {
+		const char *q;
+
+		*eol = memchr( *p, '\n', end - *p );
+		if ( *eol == NULL )
+			*eol = end;
+		for ( q=*p; q<*eol; q++ )
+			if ( *q != ' ' && *q != '\t' && *q != '\r' )
+				return 1;
+		*p = *eol + 1;
+	}
+	return 0;
+}
+
+/*
+================
+FIO_CountChunk
+
+Worker job: count the records of chunks [start,end)
+================
+*/
+void	FIO_CountChunk( void *arg, int start, int end, int worker ) {
+	fioload_t	*load;
+	int		c;
+
+	load = arg;
+	for ( c=start; c<end; c++ ) {
+		fiochunk_t	*chunk;
+		const char	*p, *eol;
+
+		chunk = load->chunks + c;
+		p = chunk->start;
+		while ( FIO_NextLine( &p, chunk->end, &eol ) ) {
+			chunk->count++;
+			p = eol + 1;
 		}
-		break;
+	}
+}
 
-		case CT_NVSS:
-		for ( i=0; i<cat->number; i++ ) {
-			double	hour, min, sec;
+/*
+================
+FIO_ParseChunk
 
-			current = cat->data + i;
+Worker job: parse chunks [start,end) into the catalog
+================
+*/
+void	FIO_ParseChunk( void *arg, int start, int end, int worker ) {
+	fioload_t	*load;
+	int		c;
 
-			if (fread( linebuffer, sizeof(linebuffer), 1, fp )==0) {
-				printf( "error reading NVSS data.\n" );
-				return 0;
+	load = arg;
+	for ( c=start; c<end; c++ ) {
+		fiochunk_t	*chunk;
+		const char	*p, *eol;
+		catdata_t	*current;
+
+		chunk = load->chunks + c;
+		current = load->cat->data + chunk->first;
+		p = chunk->start;
+		while ( FIO_NextLine( &p, chunk->end, &eol ) ) {
+			int ok;
+
+			if ( chunk->file == FIO_SDSS ) {
+				ok = FIO_ParseDouble( &p, eol, &current->ra )
+				&& FIO_ParseDouble( &p, eol, &current->dec )
+				&& FIO_ParseDouble( &p, eol, &current->z )
+				&& FIO_ParseDouble( &p, eol,
+						&current->abs_petro_r_mag )
+				&& FIO_ParseDouble( &p, eol, &current->u_b_color )
+				&& FIO_ParseDouble( &p, eol,
+						&current->stellar_mass );
+			}
+			else {
+				double cD;
+
+				ok = FIO_ParseDouble( &p, eol, &cD );
+				// TODO: calculate list in Kiloparsec
+				cD *= 1000; // from GPc to MPc
+				cD *= 1000; // from Mpc to Kpc
+				current->comovD = cD;
+			}
+			if ( !ok ) {
+				chunk->error = current - load->cat->data + 1;
+				return;
 			}
-			// Read and convert RA to degs
-			sscanf( linebuffer + 0, "%lf %lf %lf",
-								&hour,
-								&min,
-								&sec );
-
-			current->ra = (360/24)*(hour + min/60.0 + sec/3600.0);
-			// same for DEC
-			sscanf( linebuffer + 21, "%lf %lf %lf",
-								&hour,
-								&min,
-								&sec );
-			current->dec = hour + min/60.0 + sec/3600.0;
-
-			// Galactic coordinates
-			sscanf( linebuffer + 44, "%lf %lf",
-							&current->longitude,
-							&current->latitude );
-			// rotation measure
-			sscanf( linebuffer + 125, "%lf",
-							&current->rot_measure );
+			current++;
+			p = eol + 1;
 		}
-		break;
 	}
+}
+
+/*
+================
+FIO_JoinSDSS
+
+Parse the mapped SDSS and comovD texts into the catalog.
+Returns -1 on errors.
+================
+*/
+int	FIO_JoinSDSS( catalog_t *cat, const char **text, const size_t *size ) {
+	int		numChunks;
+	int		counted[2];
+	int		f, c, i;
+	fioload_t	load;
+	thrjob_t	job;
+	int		result;
+
+	// several chunks per worker so stealing can even things out
+	numChunks = 8 * THR_NumWorkers( 0 );
+	load.cat = cat;
+	load.chunks = malloc( 2 * numChunks * sizeof(fiochunk_t) );
+
+	memset( &job, 0, sizeof(thrjob_t) );
+	job.arg = &load;
+	job.number = FIO_SplitText( text[FIO_SDSS], size[FIO_SDSS],
+					FIO_SDSS, numChunks, load.chunks );
+	job.number += FIO_SplitText( text[FIO_COMOVD], size[FIO_COMOVD],
+			FIO_COMOVD, numChunks, load.chunks + job.number );
+	job.grain = 1;
+
+	// count lines, then number them per file
+	job.func = FIO_CountChunk;
+	THR_Run( &job );
+
+	counted[0] = counted[1] = 0;
+	for ( c=0; c<job.number; c++ ) {
+		f = load.chunks[c].file;
+		load.chunks[c].first = counted[f];
+		counted[f] += load.chunks[c].count;
+	}
+	if ( counted[FIO_SDSS] != counted[FIO_COMOVD] ) {
+		printf( "SDSS line mismatch: %i galaxies but %i distances.\n",
+				counted[FIO_SDSS], counted[FIO_COMOVD] );
+		free( load.chunks );
+		return -1;
+	}
+	printf( "found %i sources.\n", counted[FIO_SDSS] );
+
+	cat->data = MEM_AllocCatData( counted[FIO_SDSS] );
+	if ( cat->data == NULL ) {
+		printf( "allocation failed for %i cat data sets.\n",
+							counted[FIO_SDSS] );
+		free( load.chunks );
+		return -1;
+	}
+	cat->number = counted[FIO_SDSS];
+	printf( "allocated %i cat sets for data.\n", cat->number );
+
+	// both files straight into the records
+	job.func = FIO_ParseChunk;
+	THR_Run( &job );
+
+	result = 1;
+	for ( c=0; c<job.number; c++ )
+		if ( load.chunks[c].error ) {
+			printf( "error reading %s, line %i.\n",
+				load.chunks[c].file == FIO_SDSS ? "SDSS data"
+				: "comovD", load.chunks[c].error );
+			result = -1;
+		}
+	free( load.chunks );
+
+	if ( result == -1 ) {
+		free( cat->data );
+		cat->data = NULL;
+		cat->number = 0;
+		return -1;
+	}
+
+	for ( i=0; i<cat->number; i++ )
+		cat->data[i].angDiamD = MAT_AngDiamD( cat->data[i].z,
+						cat->data[i].comovD );
+
+	return 1;
+}
+
+/*
+================
+FIO_LoadSDSS
+
+Read the SDSS galaxies and their comoving distances on all cores.
+Returns -1 if a file is missing, does not parse or the two files do
+not match up.
+================
+*/
+int	FIO_LoadSDSS( catalog_t *cat ) {
+	const char	*text[2];
+	size_t		size[2];
+	int		result;
+
+	cat->number = 0;
+	text[FIO_SDSS] = FIO_MapText( SDSS_FILE, size+FIO_SDSS );
+	text[FIO_COMOVD] = FIO_MapText( COMOVD_FILE, size+FIO_COMOVD );
+
+	if ( text[FIO_SDSS] != NULL && text[FIO_COMOVD] != NULL )
+		result = FIO_JoinSDSS( cat, text, size );
+	else
+		result = -1;
+
+	if ( text[FIO_SDSS] != NULL )
+		munmap( (void*)text[FIO_SDSS], size[FIO_SDSS] );
+	if ( text[FIO_COMOVD] != NULL )
+		munmap( (void*)text[FIO_COMOVD], size[FIO_COMOVD] );
+
+	return result;
+}
+
+/*
+================
+FIO_DecodeSexagesimal
+
+Decode the fixed "hh mm ss.ss" RA at column 0 and "dd mm ss.s" Dec
+digits at column 22 of an NVSS record with one shuffle and one
+multiply-add. v gets hh, mm, ss, hundredths, dd, mm, ss, tenths.
+Returns 0 if the record does not have exactly this layout.
+================
+*/
+int	FIO_DecodeSexagesimal( const char *line, int *v ) {
+#if defined(__SSSE3__)
+	__m128i		a, b, da, db, pairs;
+	short		out[8];
+	int		digA, digB;
+	int		i;
+
+	a = _mm_loadu_si128( (const __m128i*)line );
+	b = _mm_loadu_si128( (const __m128i*)(line+16) );
+	da = _mm_sub_epi8( a, _mm_set1_epi8('0') );
+	db = _mm_sub_epi8( b, _mm_set1_epi8('0') );
+
+	// digits where expected: columns 0,1,3,4,6,7,9,10 and 22,23,
+	// 25,26,28,29,31 (16 lower in b)
+	digA = _mm_movemask_epi8( _mm_cmpeq_epi8(
+			_mm_min_epu8( da, _mm_set1_epi8(9) ), da ) );
+	digB = _mm_movemask_epi8( _mm_cmpeq_epi8(
+			_mm_min_epu8( db, _mm_set1_epi8(9) ), db ) );
+	if ( (digA & 0x06db) != 0x06db || (digB & 0xb6c0) != 0xb6c0 )
+		return 0;
+	if ( line[2] != ' ' || line[5] != ' ' || line[8] != '.'
+		|| line[24] != ' ' || line[27] != ' ' || line[30] != '.'
+		|| (line[21] != '+' && line[21] != '-') )
+		return 0;
+
+	// digit pairs next to each other, then tens*10 + ones
+	pairs = _mm_or_si128(
+		_mm_shuffle_epi8( da, _mm_setr_epi8( 0, 1, 3, 4, 6, 7, 9, 10,
+				-1, -1, -1, -1, -1, -1, -1, -1 ) ),
+		_mm_shuffle_epi8( db, _mm_setr_epi8( -1, -1, -1, -1, -1, -1,
+				-1, -1, 6, 7, 9, 10, 12, 13, -1, 15 ) ) );
+	_mm_storeu_si128( (__m128i*)out, _mm_maddubs_epi16( pairs,
+			_mm_setr_epi8( 10, 1, 10, 1, 10, 1, 10, 1,
+				10, 1, 10, 1, 10, 1, 10, 1 ) ) );
+	for ( i=0; i<8; i++ )
+		v[i] = out[i];
+
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+/*
+================
+FIO_ParseNVSS
+
+Parse one fixed-width NVSS record. Flux and RM error are NAN when
+missing. Returns 0 if position or RM cannot be read.
+================
+*/
+int	FIO_ParseNVSS( const char *line, catdata_t *current ) {
+	const char	*p, *end;
+	double		hour, min, sec;
+	int		v[8];
+
+	end = line + NVSS_LINE_LEN - 1;
+
+	if ( FIO_DecodeSexagesimal( line, v ) == 1 ) {
+		// same values as parsing the digits: one rounding each
+		hour = v[0];
+		min = v[1];
+		sec = (v[2]*100 + v[3]) / 100.0;
+		current->ra = (360/24)*(hour + min/60.0 + sec/3600.0);
+
+		// the sign goes with the degrees only
+		hour = line[21] == '-' ? -(double)v[4] : v[4];
+		min = v[5];
+		sec = (v[6]*10 + v[7]) / 10.0;
+		current->dec = hour + min/60.0 + sec/3600.0;
+	}
+	else {
+		// Read and convert RA to degs
+		p = line + NVSS_RA_COL;
+		if ( !FIO_ParseDouble( &p, end, &hour )
+			|| !FIO_ParseDouble( &p, end, &min )
+			|| !FIO_ParseDouble( &p, end, &sec ) )
+			return 0;
+		current->ra = (360/24)*(hour + min/60.0 + sec/3600.0);
+		// same for DEC
+		p = line + NVSS_DEC_COL;
+		if ( !FIO_ParseDouble( &p, end, &hour )
+			|| !FIO_ParseDouble( &p, end, &min )
+			|| !FIO_ParseDouble( &p, end, &sec ) )
+			return 0;
+		current->dec = hour + min/60.0 + sec/3600.0;
+	}
+
+	// Galactic coordinates
+	p = line + NVSS_GAL_COL;
+	if ( !FIO_ParseDouble( &p, end, &current->longitude )
+		|| !FIO_ParseDouble( &p, end, &current->latitude ) )
+		return 0;
+	// flux density, not in every version of the catalogue
+	p = line + NVSS_FLUX_COL;
+	if ( !FIO_ParseDouble( &p, p + NVSS_FLUX_LEN, &current->flux ) )
+		current->flux = NAN;
+	// rotation measure and its error
+	p = line + NVSS_RM_COL;
+	if ( !FIO_ParseDouble( &p, end, &current->rot_measure ) )
+		return 0;
+	if ( !FIO_ParseDouble( &p, end, &current->rot_measure_err ) )
+		current->rot_measure_err = NAN;
+
+	return 1;
+}
+
+/*
+================
+FIO_NVSSChunk
+
+Worker job: parse the NVSS records [start,end)
+================
+*/
+void	FIO_NVSSChunk( void *arg, int start, int end, int worker ) {
+	fioload_t	*load;
+	int		i;
+
+	load = arg;
+	for ( i=start; i<end; i++ ) {
+		const char *line;
+
+		line = load->text + (size_t)i*NVSS_LINE_LEN;
+		load->bad[i] = line[NVSS_LINE_LEN-1] != '\n'
+			|| FIO_ParseNVSS( line, load->cat->data+i ) == 0;
+	}
+}
+
+/*
+================
+FIO_LoadNVSS
+
+Read the fixed-width NVSS RM catalogue on all cores and report
+the parse throughput. Malformed records are reported and left out.
+Returns 0 on errors.
+================
+*/
+int	FIO_LoadNVSS( catalog_t *cat ) {
+	const char	*text;
+	size_t		size;
+	fioload_t	load;
+	thrjob_t	job;
+	struct timespec	tic, toc;
+	double		secs;
+	int		i, kept, firstBad;
+
+	cat->number = 0;
+	text = FIO_MapText( NVSS_FILE, &size );
+	if ( text == NULL )
+		return 0;
+
+	if ( size % NVSS_LINE_LEN != 0 ) {
+		printf( "%s is not made of %i byte records.\n",
+						NVSS_FILE, NVSS_LINE_LEN );
+		munmap( (void*)text, size );
+		return 0;
+	}
+	printf( "found %i sources.\n", (int)(size / NVSS_LINE_LEN) );
+
+	cat->data = MEM_AllocCatData( size / NVSS_LINE_LEN );
+	if ( cat->data == NULL ) {
+		printf( "allocation failed for %i cat data sets.\n",
+					(int)(size / NVSS_LINE_LEN) );
+		munmap( (void*)text, size );
+		return 0;
+	}
+	cat->number = size / NVSS_LINE_LEN;
+	printf( "allocated %i cat sets for data.\n", cat->number );
+
+	load.cat = cat;
+	load.chunks = NULL;
+	load.text = text;
+	load.bad = malloc( cat->number );
+	memset( &job, 0, sizeof(thrjob_t) );
+	job.func = FIO_NVSSChunk;
+	job.arg = &load;
+	job.number = cat->number;
+
+	clock_gettime( CLOCK_MONOTONIC, &tic );
+	THR_Run( &job );
+	clock_gettime( CLOCK_MONOTONIC, &toc );
+	munmap( (void*)text, size );
+
+	secs = (toc.tv_sec - tic.tv_sec) + 1e-9*(toc.tv_nsec - tic.tv_nsec);
+	printf( "parsed %.1f MB in %.4f s (%.0f MB/s, %.1f M records/s).\n",
+			size/1e6, secs, size/1e6/secs, cat->number/1e6/secs );
+
+	// drop the records that did not parse, keeping the order
+	kept = 0;
+	firstBad = 0;
+	for ( i=0; i<cat->number; i++ ) {
+		if ( load.bad[i] ) {
+			if ( firstBad == 0 )
+				firstBad = i+1;
+			continue;
+		}
+		if ( kept != i )
+			cat->data[kept] = cat->data[i];
+		kept++;
+	}
+	free( load.bad );
+	if ( kept < cat->number )
+		printf( "skipped %i malformed NVSS records, first is record %i.\n",
+					cat->number - kept, firstBad );
+	cat->number = kept;
+
+	if ( cat->number == 0 ) {
+		printf( "error reading NVSS data, no valid records.\n" );
+		free( cat->data );
+		cat->data = NULL;
+		return 0;
+	}
+
 	return 1;
 }
 
@@ -174,60 +682,508 @@ void	FIO_CloseFile( FILE *fp ) {
 
 /*
 ================
-FIO_FileToMemory
+FIO_StampSources
 
-Read data precompiled data array from file
+size and modification time of each source file, -1 if missing.
+Returns the number of sources.
 ================
 */
-int	FIO_FileToMemory( const char *name, catalog_t *cat ) {
-	FILE	*fp;
+int	FIO_StampSources( const char **sources, cachesrc_t *stamps ) {
+	int n;
 
-	fp = fopen( name, "rb" );
+	for ( n=0; sources[n]!=NULL && n<CACHE_MAX_SOURCES; n++ ) {
+		struct stat st;
 
-	if ( fp == NULL ) {
-		printf( "%s not found.\n", name );
+		if ( stat( sources[n], &st ) != 0 ) {
+			stamps[n].size = -1;
+			stamps[n].mtime = 0;
+			continue;
+		}
+		stamps[n].size = st.st_size;
+		stamps[n].mtime = st.st_mtime;
+	}
+	return n;
+}
+
+/*
+================
+FIO_CheckCache
+
+Returns 1 if a mapped cache header describes usable catalog data
+that is up to date with its sources
+================
+*/
+int	FIO_CheckCache( const char *name, const cachehdr_t *hdr, size_t size,
+						const char **sources ) {
+	cachesrc_t	stamps[CACHE_MAX_SOURCES];
+	int		i, n;
+
+	if ( size < sizeof(cachehdr_t)
+		|| memcmp( hdr->magic, CACHE_MAGIC, sizeof(hdr->magic) ) != 0 ) {
+		printf( "%s is no catalog cache.\n", name );
+		return 0;
+	}
+	if ( hdr->version != CACHE_VERSION || hdr->schema != MEM_SchemaHash()
+		|| hdr->recordSize != sizeof(catdata_t)
+		|| hdr->numFields != CF_NUMFIELDS ) {
+		printf( "%s has an old format.\n", name );
+		return 0;
+	}
+	for ( i=0; i<CF_NUMFIELDS; i++ )
+		if ( hdr->fieldOffs[i] != (int)catFieldOffs[i] ) {
+			printf( "%s has an old format.\n", name );
+			return 0;
+		}
+	if ( hdr->number < 0 || hdr->dataOffset < (long long)sizeof(cachehdr_t)
+		|| hdr->dataOffset % CACHE_PAGE != 0
+		|| hdr->dataOffset + (long long)hdr->number*sizeof(catdata_t)
+							> (long long)size ) {
+		printf( "%s is truncated.\n", name );
+		return 0;
+	}
+	if ( hdr->indexOffset != 0 && ( hdr->indexOffset % sizeof(int) != 0
+		|| hdr->indexOffset + (long long)hdr->number*sizeof(int)
+							> (long long)size ) ) {
+		printf( "%s is truncated.\n", name );
 		return 0;
 	}
 
-	if (fread( cat, sizeof(catalog_t), 1, fp )==0) {
-		printf( "error reading %s.\n", name );
+	n = FIO_StampSources( sources, stamps );
+	if ( n != hdr->numSources ) {
+		printf( "%s was made from other files.\n", name );
 		return 0;
 	}
-	// allocate data buffer
-	cat->data = malloc( cat->number * sizeof(catdata_t) );
-	if (fread( cat->data, sizeof(catdata_t)*cat->number, 1, fp )==0) {
-		printf("error reading data of %s. n is %i\n",name,cat->number);
+	for ( i=0; i<n; i++ ) {
+		// without the source the cache is all we have
+		if ( stamps[i].size < 0 ) {
+			printf( "%s missing, using %s as is.\n", sources[i], name );
+			continue;
+		}
+		if ( stamps[i].size != hdr->source[i].size
+			|| stamps[i].mtime != hdr->source[i].mtime ) {
+			printf( "%s changed since %s was made.\n",
+							sources[i], name );
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/*
+================
+FIO_MapCache
+
+Map a catalog cache read-only and check it.
+Returns the header or NULL.
+================
+*/
+cachehdr_t*	FIO_MapCache( const char *name, const char **sources,
+							size_t *size ) {
+	int		fd;
+	struct stat	st;
+	void		*map;
+
+	fd = open( name, O_RDONLY );
+	if ( fd < 0 ) {
+		printf( "%s not found.\n", name );
+		return NULL;
+	}
+	if ( fstat( fd, &st ) != 0 || st.st_size == 0 ) {
+		printf( "error reading %s.\n", name );
+		close( fd );
+		return NULL;
+	}
+
+	map = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+	close( fd );
+	if ( map == MAP_FAILED ) {
+		printf( "error mapping %s.\n", name );
 		perror( "skyplot" );
+		return NULL;
+	}
+
+	if ( FIO_CheckCache( name, map, st.st_size, sources ) == 0 ) {
+		munmap( map, st.st_size );
+		return NULL;
+	}
+
+	*size = st.st_size;
+	return map;
+}
+
+/*
+================
+FIO_CacheToMemory
+
+Map a catalog cache read-only in place of cat's data buffer
+================
+*/
+int	FIO_CacheToMemory( const char *name, catalog_t *cat,
+						const char **sources ) {
+	cachehdr_t	*hdr;
+	size_t		size;
+
+	hdr = FIO_MapCache( name, sources, &size );
+	if ( hdr == NULL )
+		return 0;
+
+	MEM_FreeDataBuffer( cat );
+	cat->type = hdr->type;
+	cat->number = hdr->number;
+	cat->threshold = hdr->threshold;
+	cat->data = (catdata_t*)((char*)hdr + hdr->dataOffset);
+	cat->cols = NULL;
+	cat->map = hdr;
+	cat->mapSize = size;
+
+	printf( "mapped %i sources from %s.\n", cat->number, name );
+
+	return 1;
+}
+
+/*
+================
+FIO_CacheToSelection
+
+Load a saved selection of the rows of sel's full catalog,
+together with its results
+================
+*/
+int	FIO_CacheToSelection( const char *name, catalog_t *sel,
+						const char **sources ) {
+	cachehdr_t	*hdr;
+	size_t		size;
+	const catdata_t	*rows;
+	const int	*index;
+	int		i, f;
+
+	hdr = FIO_MapCache( name, sources, &size );
+	if ( hdr == NULL )
+		return 0;
+
+	rows = (const catdata_t*)((char*)hdr + hdr->dataOffset);
+	index = (const int*)((char*)hdr + hdr->indexOffset);
+	if ( hdr->indexOffset == 0 || hdr->type != sel->type
+		|| hdr->number > sel->base->number ) {
+		printf( "%s is no selection of the catalog.\n", name );
+		munmap( hdr, size );
 		return 0;
 	}
+	for ( i=0; i<hdr->number; i++ )
+		if ( index[i] < 0 || index[i] >= sel->base->number ) {
+			printf( "%s is no selection of the catalog.\n", name );
+			munmap( hdr, size );
+			return 0;
+		}
 
-	printf( "loaded %i sources from %s.\n", cat->number, name );
-	fclose( fp );
+	MEM_ClearCat( sel );
+	MEM_Reserve( sel, hdr->number );
+	sel->number = hdr->number;
+	sel->threshold = hdr->threshold;
+	memcpy( sel->index, index, sel->number * sizeof(int) );
+
+	// only results that were computed get a column
+	for ( f=CF_RMMEAN; f<=CF_LASTRESULT; f++ ) {
+		double *col;
+
+		for ( i=0; i<sel->number; i++ )
+			if ( MEM_RowValue( rows+i, f ) != 0 )
+				break;
+		if ( i == sel->number )
+			continue;
+		col = MEM_ResultColumn( sel, f );
+		for ( i=0; i<sel->number; i++ )
+			col[i] = MEM_RowValue( rows+i, f );
+	}
+	munmap( hdr, size );
+
+	printf( "loaded %i sources from %s.\n", sel->number, name );
 
 	return 1;
 }
 
 /*
 ================
-FIO_MemoryToFile
+FIO_ReleaseCache
 
-Save data array to a file
+Unmap the cache holding a catalog's data
 ================
 */
-void	FIO_MemoryToFile( const char *name, catalog_t *cat ) {
-	FILE	*fp;
+void	FIO_ReleaseCache( catalog_t *cat ) {
+
+	munmap( cat->map, cat->mapSize );
+	cat->map = NULL;
+	cat->mapSize = 0;
+	cat->data = NULL;
+}
 
-	fp = fopen( name, "wb" );
+/*
+================
+FIO_MemoryToCache
+
+Save a catalog to a cache file. The file is replaced as a whole so
+processes still mapping the old one are not disturbed. Selections
+are written out as rows followed by their row numbers.
+================
+*/
+int	FIO_MemoryToCache( const char *name, catalog_t *cat,
+						const char **sources ) {
+	FILE		*fp;
+	cachehdr_t	hdr;
+	char		tmpName[256];
+	char		pad[CACHE_PAGE];
+	catdata_t	*rows;
+	int		*index;
+	int		i;
+	int		ok;
+
+	memset( &hdr, 0, sizeof(cachehdr_t) );
+	memcpy( hdr.magic, CACHE_MAGIC, sizeof(hdr.magic) );
+	hdr.version = CACHE_VERSION;
+	hdr.schema = MEM_SchemaHash();
+	hdr.type = cat->type;
+	hdr.number = cat->number;
+	hdr.threshold = cat->threshold;
+	hdr.recordSize = sizeof(catdata_t);
+	hdr.numFields = CF_NUMFIELDS;
+	for ( i=0; i<CF_NUMFIELDS; i++ )
+		hdr.fieldOffs[i] = catFieldOffs[i];
+	hdr.numSources = FIO_StampSources( sources, hdr.source );
+	hdr.dataOffset = (sizeof(cachehdr_t) + CACHE_PAGE-1)
+						/ CACHE_PAGE * CACHE_PAGE;
+	if ( cat->base != NULL )
+		hdr.indexOffset = hdr.dataOffset
+				+ (long long)cat->number * sizeof(catdata_t);
+
+	snprintf( tmpName, sizeof(tmpName), "%s.tmp", name );
+	fp = fopen( tmpName, "wb" );
 
 	if ( fp == NULL ) {
 		printf( "%s not savable.\n", name );
-		return;
+		return 0;
+	}
+
+	memset( pad, 0, sizeof(pad) );
+	ok = fwrite( &hdr, sizeof(cachehdr_t), 1, fp ) == 1;
+	ok = ok && fwrite( pad, hdr.dataOffset - sizeof(cachehdr_t), 1, fp )
+									== 1;
+	if ( cat->number > 0 && cat->base == NULL )
+		ok = ok && fwrite( cat->data, sizeof(catdata_t)*cat->number,
+								1, fp ) == 1;
+	else if ( cat->number > 0 ) {
+		rows = MEM_AllocCatData( cat->number );
+		ok = ok && rows != NULL;
+		if ( ok )
+			MEM_CopyRows( cat, rows );
+		ok = ok && fwrite( rows, sizeof(catdata_t)*cat->number,
+								1, fp ) == 1;
+		index = malloc( cat->number * sizeof(int) );
+		ok = ok && index != NULL;
+		for ( i=0; ok && i<cat->number; i++ )
+			index[i] = MEM_RowIndex( cat, i );
+		ok = ok && fwrite( index, sizeof(int)*cat->number,
+								1, fp ) == 1;
+		free( rows );
+		free( index );
 	}
+	ok = (fclose( fp ) == 0) && ok;
 
-	fwrite( cat, sizeof(catalog_t), 1, fp );
-	fwrite( cat->data, sizeof(catdata_t)*cat->number, 1, fp );
+	if ( !ok || rename( tmpName, name ) != 0 ) {
+		printf( "%s not savable.\n", name );
+		remove( tmpName );
+		return 0;
+	}
 
-	fclose( fp );
+	return 1;
+}
+
+/*
+================
+FIO_PairsToCache
+
+Save a pair table, replacing the file as a whole like
+FIO_MemoryToCache
+================
+*/
+int	FIO_PairsToCache( const char *name, const pairtable_t *pt ) {
+	FILE		*fp;
+	pairhdr_t	hdr;
+	char		tmpName[256];
+	char		pad[CACHE_PAGE];
+	int		ok;
+
+	memset( &hdr, 0, sizeof(pairhdr_t) );
+	memcpy( hdr.magic, PAIR_MAGIC, sizeof(hdr.magic) );
+	hdr.version = PAIR_VERSION;
+	hdr.radius = pt->radius;
+	hdr.numNVSS = pt->numNVSS;
+	hdr.numSDSS = pt->numSDSS;
+	hdr.numPairs = pt->numPairs;
+	hdr.numSources[0] = FIO_StampSources( MEM_CatSources( CT_NVSS ),
+							hdr.source[0] );
+	hdr.numSources[1] = FIO_StampSources( MEM_CatSources( CT_SDSS ),
+							hdr.source[1] );
+	// pairs first, page aligned, the byte maps last
+	hdr.pairOffset = (sizeof(pairhdr_t) + CACHE_PAGE-1)
+						/ CACHE_PAGE * CACHE_PAGE;
+	hdr.startOffset = hdr.pairOffset
+				+ (long long)pt->numPairs * sizeof(xmpair_t);
+	hdr.nvssOffset = hdr.startOffset
+				+ (long long)(pt->numNVSS+1) * sizeof(int);
+	hdr.sdssOffset = hdr.nvssOffset + pt->numNVSS;
+
+	snprintf( tmpName, sizeof(tmpName), "%s.tmp", name );
+	fp = fopen( tmpName, "wb" );
+
+	if ( fp == NULL ) {
+		printf( "%s not savable.\n", name );
+		return 0;
+	}
+
+	memset( pad, 0, sizeof(pad) );
+	ok = fwrite( &hdr, sizeof(pairhdr_t), 1, fp ) == 1;
+	ok = ok && fwrite( pad, hdr.pairOffset - sizeof(pairhdr_t), 1, fp )
+									== 1;
+	ok = ok && ( pt->numPairs == 0 || fwrite( pt->pairs,
+			sizeof(xmpair_t)*pt->numPairs, 1, fp ) == 1 );
+	ok = ok && fwrite( pt->start, sizeof(int)*(pt->numNVSS+1), 1, fp ) == 1;
+	ok = ok && ( pt->numNVSS == 0
+			|| fwrite( pt->nvssDone, pt->numNVSS, 1, fp ) == 1 );
+	ok = ok && ( pt->numSDSS == 0
+			|| fwrite( pt->sdssDone, pt->numSDSS, 1, fp ) == 1 );
+	ok = (fclose( fp ) == 0) && ok;
+
+	if ( !ok || rename( tmpName, name ) != 0 ) {
+		printf( "%s not savable.\n", name );
+		remove( tmpName );
+		return 0;
+	}
+
+	return 1;
+}
+
+/*
+================
+FIO_CheckPairs
+
+Returns 1 if a mapped pair table fits the loaded catalogs and
+is up to date with their sources
+================
+*/
+int	FIO_CheckPairs( const char *name, const pairhdr_t *hdr, size_t size ) {
+	cachesrc_t	stamps[CACHE_MAX_SOURCES];
+	int		c, i, n;
+
+	if ( size < sizeof(pairhdr_t)
+		|| memcmp( hdr->magic, PAIR_MAGIC, sizeof(hdr->magic) ) != 0 ) {
+		printf( "%s is no pair table.\n", name );
+		return 0;
+	}
+	if ( hdr->version != PAIR_VERSION ) {
+		printf( "%s has an old format.\n", name );
+		return 0;
+	}
+	if ( hdr->numNVSS != nvss_full.number
+		|| hdr->numSDSS != sdss_full.number ) {
+		printf( "%s was made for other catalogs.\n", name );
+		return 0;
+	}
+	if ( hdr->numPairs < 0 || hdr->pairOffset % CACHE_PAGE != 0
+		|| hdr->startOffset != hdr->pairOffset
+				+ (long long)hdr->numPairs * sizeof(xmpair_t)
+		|| hdr->nvssOffset != hdr->startOffset
+				+ (long long)(hdr->numNVSS+1) * sizeof(int)
+		|| hdr->sdssOffset != hdr->nvssOffset + hdr->numNVSS
+		|| hdr->sdssOffset + hdr->numSDSS > (long long)size ) {
+		printf( "%s is truncated.\n", name );
+		return 0;
+	}
+
+	for ( c=0; c<2; c++ ) {
+		n = FIO_StampSources( MEM_CatSources( c ? CT_SDSS : CT_NVSS ),
+								stamps );
+		if ( n != hdr->numSources[c] ) {
+			printf( "%s was made from other files.\n", name );
+			return 0;
+		}
+		for ( i=0; i<n; i++ )
+			if ( stamps[i].size >= 0
+				&& ( stamps[i].size != hdr->source[c][i].size
+				|| stamps[i].mtime != hdr->source[c][i].mtime ) ) {
+				printf( "Sources changed since %s was made.\n",
+									name );
+				return 0;
+			}
+	}
+
+	return 1;
+}
+
+/*
+================
+FIO_CacheToPairs
+
+Map a saved pair table read-only
+================
+*/
+int	FIO_CacheToPairs( const char *name, pairtable_t *pt ) {
+	int		fd;
+	struct stat	st;
+	char		*map;
+	pairhdr_t	*hdr;
+
+	fd = open( name, O_RDONLY );
+	if ( fd < 0 ) {
+		printf( "%s not found.\n", name );
+		return 0;
+	}
+	if ( fstat( fd, &st ) != 0 || st.st_size == 0 ) {
+		printf( "error reading %s.\n", name );
+		close( fd );
+		return 0;
+	}
+
+	map = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+	close( fd );
+	if ( map == MAP_FAILED ) {
+		printf( "error mapping %s.\n", name );
+		perror( "skyplot" );
+		return 0;
+	}
+
+	hdr = (pairhdr_t*)map;
+	if ( FIO_CheckPairs( name, hdr, st.st_size ) == 0 ) {
+		munmap( map, st.st_size );
+		return 0;
+	}
+
+	pt->radius = hdr->radius;
+	pt->numNVSS = hdr->numNVSS;
+	pt->numSDSS = hdr->numSDSS;
+	pt->numPairs = hdr->numPairs;
+	pt->pairs = (xmpair_t*)(map + hdr->pairOffset);
+	pt->start = (int*)(map + hdr->startOffset);
+	pt->nvssDone = (unsigned char*)(map + hdr->nvssOffset);
+	pt->sdssDone = (unsigned char*)(map + hdr->sdssOffset);
+	pt->map = map;
+	pt->mapSize = st.st_size;
+
+	return 1;
+}
+
+/*
+================
+FIO_ReleasePairs
+
+Unmap a pair table
+================
+*/
+void	FIO_ReleasePairs( pairtable_t *pt ) {
+
+	munmap( pt->map, pt->mapSize );
+	pt->map = NULL;
+	pt->mapSize = 0;
 }
 
 /*
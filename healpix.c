@@ -0,0 +1,397 @@
+/*
+* healpix.c - HEALPix sky pixelization (nested scheme)
+*
+* Copyright (C) 2012 Michael Rieder <mr@student.ethz.ch>
+*
+* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or (at
+* your option) any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+*
+* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*/
+
+#include "skyplot.h"
+
+/*
+* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+* BASE PIXEL LAYOUT
+* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*/
+
+// ring and phi offset of the base pixels
+static const int	jrll[12] = { 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4 };
+static const int	jpll[12] = { 1, 3, 5, 7, 0, 2, 4, 6, 1, 3, 5, 7 };
+
+
+/*
+================
+HPX_Spread
+
+interleave the bits of v with zeros
+================
+*/
+int	HPX_Spread( int v ) {
+	unsigned int x;
+
+	x = v & 0xffff;
+	x = (x | (x << 8)) & 0x00ff00ff;
+	x = (x | (x << 4)) & 0x0f0f0f0f;
+	x = (x | (x << 2)) & 0x33333333;
+	x = (x | (x << 1)) & 0x55555555;
+
+	return x;
+}
+
+/*
+================
+HPX_Compress
+
+inverse of HPX_Spread
+================
+*/
+int	HPX_Compress( int v ) {
+	unsigned int x;
+
+	x = v & 0x55555555;
+	x = (x | (x >> 1)) & 0x33333333;
+	x = (x | (x >> 2)) & 0x0f0f0f0f;
+	x = (x | (x >> 4)) & 0x00ff00ff;
+	x = (x | (x >> 8)) & 0x0000ffff;
+
+	return x;
+}
+
+/*
+================
+HPX_NumPix
+
+number of pixels at an order
+================
+*/
+int	HPX_NumPix( int order ) {
+
+	return 12 << (2*order);
+}
+
+/*
+================
+HPX_XYF2Pix
+
+face coordinates to nested pixel index
+================
+*/
+int	HPX_XYF2Pix( int order, int ix, int iy, int face ) {
+
+	return (face << (2*order)) + HPX_Spread(ix) + (HPX_Spread(iy) << 1);
+}
+
+/*
+================
+HPX_Pix2XYF
+
+nested pixel index to face coordinates
+================
+*/
+void	HPX_Pix2XYF( int order, int pix, int *ix, int *iy, int *face ) {
+	int p;
+
+	*face = pix >> (2*order);
+	p = pix & ((1 << (2*order)) - 1);
+	*ix = HPX_Compress( p );
+	*iy = HPX_Compress( p >> 1 );
+}
+
+/*
+================
+HPX_Loc2Pix
+
+z = cos(theta), phi and sin(theta) to nested pixel index
+================
+*/
+int	HPX_Loc2Pix( int order, double z, double phi, double sth ) {
+	int	nside;
+	double	za;
+	double	tt;
+
+	nside = 1 << order;
+	za = fabs( z );
+	tt = fmod( phi*2.0/M_PI, 4.0 );
+	if ( tt < 0 )
+		tt += 4.0;
+
+	if ( za <= 2.0/3.0 ) {
+		// equatorial region
+		double	temp1, temp2;
+		int	jp, jm, ifp, ifm;
+		int	face;
+
+		temp1 = nside*(0.5+tt);
+		temp2 = nside*(z*0.75);
+		jp = (int)(temp1-temp2);	// ascending edge line
+		jm = (int)(temp1+temp2);	// descending edge line
+		ifp = jp >> order;
+		ifm = jm >> order;
+		if ( ifp == ifm )
+			face = ifp | 4;
+		else if ( ifp < ifm )
+			face = ifp;
+		else
+			face = ifm + 8;
+
+		return HPX_XYF2Pix( order, jm & (nside-1),
+					nside - (jp & (nside-1)) - 1, face );
+	}
+	else {
+		// polar caps
+		int	ntt;
+		double	tp, tmp;
+		int	jp, jm;
+
+		ntt = (int)tt;
+		if ( ntt > 3 )
+			ntt = 3;
+		tp = tt - ntt;
+		// sin(theta) is more precise than 1-|z| near the poles
+		if ( za < 0.99 )
+			tmp = nside*sqrt( 3*(1-za) );
+		else
+			tmp = nside*sth/sqrt( (1.0+za)/3.0 );
+
+		jp = (int)(tp*tmp);
+		jm = (int)((1.0-tp)*tmp);
+		if ( jp > nside-1 )
+			jp = nside-1;
+		if ( jm > nside-1 )
+			jm = nside-1;
+
+		if ( z > 0 )
+			return HPX_XYF2Pix( order, nside-jm-1, nside-jp-1, ntt );
+		else
+			return HPX_XYF2Pix( order, jp, jm, ntt+8 );
+	}
+}
+
+/*
+================
+HPX_Vec2Pix
+
+unit vector to nested pixel index
+================
+*/
+int	HPX_Vec2Pix( int order, const double *vec ) {
+
+	return HPX_Loc2Pix( order, vec[2], atan2(vec[1],vec[0]),
+				sqrt(vec[0]*vec[0]+vec[1]*vec[1]) );
+}
+
+/*
+================
+HPX_XYF2Vec
+
+continuous face coordinates (in pixels) to unit vector
+================
+*/
+void	HPX_XYF2Vec( int order, double x, double y, int face, double *vec ) {
+	double	nside;
+	double	jr, nr;
+	double	z, sth, phi, tmp;
+
+	nside = (double)(1 << order);
+	jr = jrll[face]*nside - x - y;
+
+	if ( jr < nside ) {
+		nr = jr;
+		tmp = nr*nr/(3*nside*nside);
+		z = 1 - tmp;
+		sth = sqrt( tmp*(2-tmp) );
+	}
+	else if ( jr > 3*nside ) {
+		nr = 4*nside - jr;
+		tmp = nr*nr/(3*nside*nside);
+		z = tmp - 1;
+		sth = sqrt( tmp*(2-tmp) );
+	}
+	else {
+		nr = nside;
+		z = (2*nside-jr)*2.0/(3*nside);
+		sth = sqrt( (1-z)*(1+z) );
+	}
+
+	tmp = jpll[face]*nr + x - y;
+	if ( tmp < 0 )
+		tmp += 8*nr;
+	if ( tmp >= 8*nr )
+		tmp -= 8*nr;
+	phi = (nr < 1e-15) ? 0 : (0.25*M_PI*tmp)/nr;
+
+	vec[0] = sth*cos(phi);
+	vec[1] = sth*sin(phi);
+	vec[2] = z;
+}
+
+/*
+================
+HPX_Pix2Vec
+
+pixel center as unit vector
+================
+*/
+void	HPX_Pix2Vec( int order, int pix, double *vec ) {
+	int ix, iy, face;
+
+	HPX_Pix2XYF( order, pix, &ix, &iy, &face );
+	HPX_XYF2Vec( order, ix+0.5, iy+0.5, face, vec );
+}
+
+/*
+================
+HPX_MaxPixRad
+
+largest angle between a pixel center and its corners (radians)
+================
+*/
+double	HPX_MaxPixRad( int order ) {
+	int	nside;
+	double	za, zb, t1;
+	double	dot;
+
+	nside = 1 << order;
+	// pixel of the first polar ring next to the equatorial region
+	za = 2.0/3.0;
+	t1 = 1.0 - 1.0/nside;
+	t1 *= t1;
+	zb = 1.0 - t1/3.0;
+
+	dot = sqrt((1-za*za)*(1-zb*zb))*cos( M_PI/(4*nside) ) + za*zb;
+	if ( dot > 1 )
+		dot = 1;
+
+	return acos( dot );
+}
+
+/*
+================
+HPX_OrderForRadius
+
+finest order whose pixels are still about as large as radius (rad)
+================
+*/
+int	HPX_OrderForRadius( double radius ) {
+	int order;
+
+	for ( order=0; order<HPX_MAX_MAPORDER; order++ )
+		if ( HPX_MaxPixRad(order+1) < radius )
+			break;
+
+	return order;
+}
+
+/*
+================
+HPX_ListAppend
+
+append a value to a growable list
+================
+*/
+void	HPX_ListAppend( hpxlist_t *list, int value ) {
+
+	if ( list->num == list->size ) {
+		list->size = list->size ? 2*list->size : 64;
+		list->pix = realloc( list->pix, list->size * sizeof(int) );
+	}
+	list->pix[list->num++] = value;
+}
+
+/*
+================
+HPX_QueryDiscRec
+
+descend into the children of a pixel that may touch the disc
+================
+*/
+void	HPX_QueryDiscRec( int level, int pix, int order, const double *vec,
+			const double *cosReach, hpxlist_t *list ) {
+	double	center[3];
+	int	c;
+
+	HPX_Pix2Vec( level, pix, center );
+	if ( center[0]*vec[0]+center[1]*vec[1]+center[2]*vec[2]
+							< cosReach[level] )
+		return;
+
+	if ( level == order ) {
+		HPX_ListAppend( list, pix );
+		return;
+	}
+	for ( c=0; c<4; c++ )
+		HPX_QueryDiscRec( level+1, 4*pix+c, order, vec, cosReach, list );
+}
+
+/*
+================
+HPX_QueryDisc
+
+collect all pixels that may overlap a disc around vec.
+The result is inclusive: it may contain a few pixels just outside.
+================
+*/
+void	HPX_QueryDisc( int order, const double *vec, double radius,
+							hpxlist_t *list ) {
+	double	cosReach[HPX_MAX_ORDER+1];
+	int	level;
+	int	face;
+
+	list->num = 0;
+
+	// a pixel center within radius + pixel size may overlap
+	for ( level=0; level<=order; level++ ) {
+		double reach;
+
+		reach = radius + HPX_MaxPixRad( level );
+		cosReach[level] = (reach >= M_PI) ? -2.0 : cos( reach );
+	}
+
+	for ( face=0; face<12; face++ )
+		HPX_QueryDiscRec( 0, face, order, vec, cosReach, list );
+}
+
+/*
+================
+HPX_CatalogPix
+
+pixel index of every source of a catalog
+================
+*/
+void	HPX_CatalogPix( int order, catalog_t *cat, int galactic, int *pix ) {
+	int i;
+
+	if ( galactic == 0 )
+		for ( i=0; i<cat->number; i++ ) {
+			const catdata_t *cd;
+
+			cd = MEM_Row( cat, i );
+			pix[i] = HPX_Loc2Pix( order, cd->vec[2],
+						RAD*cd->ra, cd->cosdec );
+		}
+	else
+		for ( i=0; i<cat->number; i++ ) {
+			const catdata_t *cd;
+
+			cd = MEM_Row( cat, i );
+			pix[i] = HPX_Loc2Pix( order, sin(RAD*cd->latitude),
+						RAD*cd->longitude,
+						cos(RAD*cd->latitude) );
+		}
+}
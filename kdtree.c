@@ -0,0 +1,491 @@
+/*
+* kdtree.c - k-d tree on unit vectors for nearest neighbor searches
+*
+* Copyright (C) 2012 Michael Rieder <mr@student.ethz.ch>
+*
+* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or (at
+* your option) any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+*
+* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*/
+
+#include "skyplot.h"
+
+/*
+* The tree is implicit: the node of a range [lo,hi) of the point arrays
+* is the median element (lo+hi)/2, its left subtree is [lo,mid) and its
+* right subtree is [mid+1,hi).
+*/
+
+/*
+================
+KDT_Swap
+
+swap two points of the tree arrays
+================
+*/
+void	KDT_Swap( kdtree_t *tree, int a, int b ) {
+	int	k;
+	int	tmp;
+
+	for ( k=0; k<3; k++ ) {
+		double t;
+
+		t = tree->pos[3*a+k];
+		tree->pos[3*a+k] = tree->pos[3*b+k];
+		tree->pos[3*b+k] = t;
+	}
+	tmp = tree->index[a];
+	tree->index[a] = tree->index[b];
+	tree->index[b] = tmp;
+}
+
+/*
+================
+KDT_Select
+
+partially sort [lo,hi) along dim so that element k is in place
+================
+*/
+void	KDT_Select( kdtree_t *tree, int lo, int hi, int k, int dim ) {
+
+	hi--;
+	while ( lo < hi ) {
+		double	pivot;
+		int	i, j;
+
+		pivot = tree->pos[3*((lo+hi)/2)+dim];
+		i = lo;
+		j = hi;
+		while ( i <= j ) {
+			while ( tree->pos[3*i+dim] < pivot )
+				i++;
+			while ( tree->pos[3*j+dim] > pivot )
+				j--;
+			if ( i <= j ) {
+				KDT_Swap( tree, i, j );
+				i++;
+				j--;
+			}
+		}
+		if ( k <= j )
+			hi = j;
+		else if ( k >= i )
+			lo = i;
+		else
+			return;
+	}
+}
+
+/*
+================
+KDT_BuildRange
+
+split a range along its widest coordinate and recurse
+================
+*/
+void	KDT_BuildRange( kdtree_t *tree, int lo, int hi ) {
+	int	i, k;
+	int	mid;
+	int	dim;
+	double	minv[3], maxv[3];
+
+	if ( hi - lo < 2 ) {
+		if ( hi > lo )
+			tree->dim[lo] = 0;
+		return;
+	}
+
+	for ( k=0; k<3; k++ ) {
+		minv[k] = 2.0;
+		maxv[k] = -2.0;
+	}
+	for ( i=lo; i<hi; i++ )
+		for ( k=0; k<3; k++ ) {
+			if ( tree->pos[3*i+k] < minv[k] )
+				minv[k] = tree->pos[3*i+k];
+			if ( tree->pos[3*i+k] > maxv[k] )
+				maxv[k] = tree->pos[3*i+k];
+		}
+	dim = 0;
+	for ( k=1; k<3; k++ )
+		if ( maxv[k]-minv[k] > maxv[dim]-minv[dim] )
+			dim = k;
+
+	mid = (lo+hi)/2;
+	KDT_Select( tree, lo, hi, mid, dim );
+	tree->dim[mid] = dim;
+
+	KDT_BuildRange( tree, lo, mid );
+	KDT_BuildRange( tree, mid+1, hi );
+}
+
+/*
+================
+KDT_Build
+
+build a k-d tree over the unit vectors of a catalog
+================
+*/
+void	KDT_Build( kdtree_t *tree, catalog_t *cat ) {
+	int	i;
+	double	*x, *y, *z;
+
+	KDT_Free( tree );
+
+	tree->number = cat->number;
+	tree->pos = malloc( 3 * cat->number * sizeof(double) );
+	tree->index = malloc( cat->number * sizeof(int) );
+	tree->dim = malloc( cat->number * sizeof(char) );
+
+	x = MEM_Column( cat, CF_VECX );
+	y = MEM_Column( cat, CF_VECY );
+	z = MEM_Column( cat, CF_VECZ );
+	for ( i=0; i<cat->number; i++ ) {
+		tree->pos[3*i+0] = x[i];
+		tree->pos[3*i+1] = y[i];
+		tree->pos[3*i+2] = z[i];
+		tree->index[i] = i;
+	}
+
+	KDT_BuildRange( tree, 0, tree->number );
+}
+
+/*
+================
+KDT_Farther
+
+heap order: larger distance first, ties by larger catalog index
+================
+*/
+int	KDT_Farther( const kdnn_t *a, const kdnn_t *b ) {
+
+	if ( a->dist2 != b->dist2 )
+		return a->dist2 > b->dist2;
+	return a->index > b->index;
+}
+
+/*
+================
+KDT_SiftDown
+
+restore the max-heap below position i
+================
+*/
+void	KDT_SiftDown( kdnn_t *heap, int num, int i ) {
+
+	while ( 1 ) {
+		int	largest, l, r;
+		kdnn_t	tmp;
+
+		largest = i;
+		l = 2*i+1;
+		r = 2*i+2;
+		if ( l < num && KDT_Farther( heap+l, heap+largest ) )
+			largest = l;
+		if ( r < num && KDT_Farther( heap+r, heap+largest ) )
+			largest = r;
+		if ( largest == i )
+			return;
+
+		tmp = heap[i];
+		heap[i] = heap[largest];
+		heap[largest] = tmp;
+		i = largest;
+	}
+}
+
+/*
+================
+KDT_Offer
+
+offer a candidate to the bounded max-heap of the k closest
+================
+*/
+void	KDT_Offer( kdnn_t *heap, int *num, int k, double dist2, int index ) {
+	kdnn_t	cand;
+	int	i;
+
+	cand.dist2 = dist2;
+	cand.index = index;
+
+	if ( *num < k ) {
+		// sift up
+		i = (*num)++;
+		while ( i > 0 && KDT_Farther( &cand, heap+(i-1)/2 ) ) {
+			heap[i] = heap[(i-1)/2];
+			i = (i-1)/2;
+		}
+		heap[i] = cand;
+		return;
+	}
+
+	// replace the farthest one if closer
+	if ( KDT_Farther( heap, &cand ) ) {
+		heap[0] = cand;
+		KDT_SiftDown( heap, *num, 0 );
+	}
+}
+
+/*
+================
+KDT_SearchRange
+
+recursive k nearest neighbor search in [lo,hi)
+================
+*/
+void	KDT_SearchRange( const kdtree_t *tree, int lo, int hi,
+			const double *vec, int skip, int k,
+			kdnn_t *heap, int *num ) {
+	int		mid;
+	int		dim;
+	const double	*p;
+	double		dx, dy, dz;
+	double		diff;
+
+	if ( lo >= hi )
+		return;
+
+	mid = (lo+hi)/2;
+	dim = tree->dim[mid];
+	p = tree->pos + 3*mid;
+
+	dx = p[0] - vec[0];
+	dy = p[1] - vec[1];
+	dz = p[2] - vec[2];
+	if ( tree->index[mid] != skip )
+		KDT_Offer( heap, num, k, dx*dx+dy*dy+dz*dz, tree->index[mid] );
+
+	// near side first, far side only if it can hold anything closer
+	diff = vec[dim] - p[dim];
+	if ( diff < 0 ) {
+		KDT_SearchRange( tree, lo, mid, vec, skip, k, heap, num );
+		if ( *num < k || diff*diff <= heap[0].dist2 )
+			KDT_SearchRange( tree, mid+1, hi, vec, skip, k, heap, num );
+	}
+	else {
+		KDT_SearchRange( tree, mid+1, hi, vec, skip, k, heap, num );
+		if ( *num < k || diff*diff <= heap[0].dist2 )
+			KDT_SearchRange( tree, lo, mid, vec, skip, k, heap, num );
+	}
+}
+
+/*
+================
+KDT_Nearest
+
+find the k nearest neighbors of vec, leaving out catalog index skip.
+heap must hold k entries, the result is sorted by increasing distance.
+Returns the number of neighbors found.
+================
+*/
+int	KDT_Nearest( const kdtree_t *tree, const double *vec, int skip, int k,
+							kdnn_t *heap ) {
+	int num;
+	int n;
+
+	num = 0;
+	KDT_SearchRange( tree, 0, tree->number, vec, skip, k, heap, &num );
+
+	// heap sort: repeatedly move the farthest to the end
+	for ( n=num-1; n>0; n-- ) {
+		kdnn_t tmp;
+
+		tmp = heap[0];
+		heap[0] = heap[n];
+		heap[n] = tmp;
+		KDT_SiftDown( heap, n, 0 );
+	}
+
+	return num;
+}
+
+/*
+================
+KDT_AggregateRange
+
+bounding box and value sums of the subtree [lo,hi), stored at its node
+================
+*/
+void	KDT_AggregateRange( kdtree_t *tree, int lo, int hi ) {
+	int	mid;
+	int	k;
+	double	*box;
+	double	v;
+
+	mid = (lo+hi)/2;
+	box = tree->box + 6*mid;
+	v = tree->value[mid];
+	for ( k=0; k<3; k++ ) {
+		box[k] = tree->pos[3*mid+k];
+		box[3+k] = tree->pos[3*mid+k];
+	}
+	tree->sum[mid] = v;
+	tree->sum2[mid] = v*v;
+
+	// merge the children
+	if ( mid > lo ) {
+		int child = (lo+mid)/2;
+
+		KDT_AggregateRange( tree, lo, mid );
+		for ( k=0; k<3; k++ ) {
+			if ( tree->box[6*child+k] < box[k] )
+				box[k] = tree->box[6*child+k];
+			if ( tree->box[6*child+3+k] > box[3+k] )
+				box[3+k] = tree->box[6*child+3+k];
+		}
+		tree->sum[mid] += tree->sum[child];
+		tree->sum2[mid] += tree->sum2[child];
+	}
+	if ( hi > mid+1 ) {
+		int child = (mid+1+hi)/2;
+
+		KDT_AggregateRange( tree, mid+1, hi );
+		for ( k=0; k<3; k++ ) {
+			if ( tree->box[6*child+k] < box[k] )
+				box[k] = tree->box[6*child+k];
+			if ( tree->box[6*child+3+k] > box[3+k] )
+				box[3+k] = tree->box[6*child+3+k];
+		}
+		tree->sum[mid] += tree->sum[child];
+		tree->sum2[mid] += tree->sum2[child];
+	}
+}
+
+/*
+================
+KDT_Aggregate
+
+cache a bounding box and the sum and sum of squares of value
+(indexed by catalog row) in every node of the tree
+================
+*/
+void	KDT_Aggregate( kdtree_t *tree, const double *value ) {
+	int	i;
+
+	free( tree->box );
+	free( tree->value );
+	free( tree->sum );
+	free( tree->sum2 );
+
+	tree->box = malloc( 6 * tree->number * sizeof(double) );
+	tree->value = malloc( tree->number * sizeof(double) );
+	tree->sum = malloc( tree->number * sizeof(double) );
+	tree->sum2 = malloc( tree->number * sizeof(double) );
+	for ( i=0; i<tree->number; i++ )
+		tree->value[i] = value[tree->index[i]];
+
+	if ( tree->number > 0 )
+		KDT_AggregateRange( tree, 0, tree->number );
+}
+
+/*
+================
+KDT_DiscRange
+
+add up the points of [lo,hi) inside the disc. Subtrees whose box lies
+entirely inside are taken whole from the node sums, only those cut by
+the boundary are descended into.
+================
+*/
+void	KDT_DiscRange( const kdtree_t *tree, int lo, int hi,
+			const double *vec, double cosRadius, double chord2,
+			int skip, kdsum_t *out ) {
+	int		mid;
+	int		k;
+	const double	*box;
+	double		near2, far2;
+
+	if ( lo >= hi )
+		return;
+
+	mid = (lo+hi)/2;
+	box = tree->box + 6*mid;
+
+	// closest and farthest squared distance of the box to vec
+	near2 = 0.0;
+	far2 = 0.0;
+	for ( k=0; k<3; k++ ) {
+		double dmin, dmax;
+
+		dmin = vec[k] - box[k];
+		dmax = box[3+k] - vec[k];
+		if ( dmin < 0 )
+			near2 += dmin*dmin;
+		else if ( dmax < 0 )
+			near2 += dmax*dmax;
+		far2 += dmin > dmax ? dmin*dmin : dmax*dmax;
+	}
+
+	// margin keeps points right at the boundary to the exact test
+	if ( near2 > chord2 + KDT_DISC_EPSILON )
+		return;
+	if ( far2 < chord2 - KDT_DISC_EPSILON ) {
+		out->num += hi - lo;
+		out->sum += tree->sum[mid];
+		out->sum2 += tree->sum2[mid];
+		if ( skip >= lo && skip < hi ) {
+			out->num--;
+			out->sum -= tree->value[skip];
+			out->sum2 -= tree->value[skip]*tree->value[skip];
+		}
+		return;
+	}
+
+	if ( mid != skip && MAT_Dot( tree->pos+3*mid, vec ) > cosRadius ) {
+		out->num++;
+		out->sum += tree->value[mid];
+		out->sum2 += tree->value[mid]*tree->value[mid];
+	}
+	KDT_DiscRange( tree, lo, mid, vec, cosRadius, chord2, skip, out );
+	KDT_DiscRange( tree, mid+1, hi, vec, cosRadius, chord2, skip, out );
+}
+
+/*
+================
+KDT_DiscSum
+
+count, sum and sum of squares of the aggregated values of all points
+whose dot product with vec exceeds cosRadius, leaving out the point at
+tree position skip
+================
+*/
+void	KDT_DiscSum( const kdtree_t *tree, const double *vec,
+			double cosRadius, int skip, kdsum_t *out ) {
+
+	memset( out, 0, sizeof(kdsum_t) );
+	KDT_DiscRange( tree, 0, tree->number, vec, cosRadius,
+					2.0 - 2.0*cosRadius, skip, out );
+}
+
+/*
+================
+KDT_Free
+
+free the k-d tree
+================
+*/
+void	KDT_Free( kdtree_t *tree ) {
+
+	free( tree->pos );
+	free( tree->index );
+	free( tree->dim );
+	free( tree->box );
+	free( tree->value );
+	free( tree->sum );
+	free( tree->sum2 );
+	memset( tree, 0, sizeof(kdtree_t) );
+}
@@ -24,39 +24,130 @@
 
 #include "skyplot.h"
 
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 
 /*
 ================
-MAT_GreatCircD
+MAT_AngDiamD
 
-great circle distance in units of radians (RAD)
+Angular diameter distance = comovD / (1+z)
 ================
 */
-double	MAT_GreatCircD(double dra,double ddec,double cosdec1,double cosdec2) {
-	double a, b, c;
+double	MAT_AngDiamD( double z, double comovD ) {
+	double a;
 
-	a = sin(ddec/2);
-	b = sin(dra/2);
+	a = comovD / (1+z);
 
-	c = sqrt(a*a + cosdec1*cosdec2*b*b);
+	return a;
+}
 
-	return 2*asin(c);
+/*
+================
+MAT_UnitVector
+
+Cartesian unit vector of RA/Dec in deg
+================
+*/
+void	MAT_UnitVector( double ra, double dec, double *vec ) {
+	double cosdec;
+
+	cosdec = cos(RAD*dec);
+	vec[0] = cosdec*cos(RAD*ra);
+	vec[1] = cosdec*sin(RAD*ra);
+	vec[2] = sin(RAD*dec);
 }
 
 /*
 ================
-MAT_AngDiamD
+MAT_Dot
 
-Angular diameter distance = comovD / (1+z)
+dot product of two unit vectors = cos(great circle distance)
 ================
 */
-double	MAT_AngDiamD( double z, double comovD ) {
-	double a;
+double	MAT_Dot( const double *a, const double *b ) {
 
-	a = comovD / (1+z);
+	return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
 
-	return a;
+/*
+================
+MAT_FirstDotAbove
+
+First entry in [lo,hi) of the coordinate columns x/y/z whose dot
+product with vec exceeds its own threshold in cosv, or -1.
+The sums are formed in the same order as MAT_Dot, so the vector
+and scalar paths accept exactly the same entries.
+================
+*/
+int	MAT_FirstDotAbove( const double *x, const double *y, const double *z,
+			const double *cosv, int lo, int hi, const double *vec ) {
+	int i;
+
+	i = lo;
+#if defined(__AVX512F__)
+	{
+		__m512d	v0, v1, v2;
+
+		v0 = _mm512_set1_pd( vec[0] );
+		v1 = _mm512_set1_pd( vec[1] );
+		v2 = _mm512_set1_pd( vec[2] );
+		for ( ; i+8<=hi; i+=8 ) {
+			__m512d		d;
+			__mmask8	m;
+
+			d = _mm512_add_pd(
+				_mm512_add_pd( _mm512_mul_pd( _mm512_loadu_pd(x+i), v0 ),
+					_mm512_mul_pd( _mm512_loadu_pd(y+i), v1 ) ),
+				_mm512_mul_pd( _mm512_loadu_pd(z+i), v2 ) );
+			m = _mm512_cmp_pd_mask( d, _mm512_loadu_pd(cosv+i),
+								_CMP_GT_OQ );
+			if ( m )
+				return i + __builtin_ctz( m );
+		}
+	}
+#elif defined(__AVX2__)
+	{
+		__m256d	v0, v1, v2;
+
+		v0 = _mm256_set1_pd( vec[0] );
+		v1 = _mm256_set1_pd( vec[1] );
+		v2 = _mm256_set1_pd( vec[2] );
+		for ( ; i+4<=hi; i+=4 ) {
+			__m256d	d;
+			int	m;
+
+			d = _mm256_add_pd(
+				_mm256_add_pd( _mm256_mul_pd( _mm256_loadu_pd(x+i), v0 ),
+					_mm256_mul_pd( _mm256_loadu_pd(y+i), v1 ) ),
+				_mm256_mul_pd( _mm256_loadu_pd(z+i), v2 ) );
+			m = _mm256_movemask_pd( _mm256_cmp_pd( d,
+					_mm256_loadu_pd(cosv+i), _CMP_GT_OQ ) );
+			if ( m )
+				return i + __builtin_ctz( m );
+		}
+	}
+#endif
+	// remainder, or everything without SIMD
+	for ( ; i<hi; i++ )
+		if ( x[i]*vec[0] + y[i]*vec[1] + z[i]*vec[2] > cosv[i] )
+			return i;
+
+	return -1;
+}
+
+/*
+================
+MAT_ChordAngle
+
+great circle distance (RAD) from a squared chord length
+================
+*/
+double	MAT_ChordAngle( double chord2 ) {
+
+	return 2*asin( sqrt(chord2)/2 );
 }
 
 /*
@@ -22,6 +22,8 @@
 * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 */
 
+#include <unistd.h>
+#include <sys/resource.h>
 #include "skyplot.h"
 
 /*
@@ -30,8 +32,6 @@
 * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 */
 
-FILE		*fp;
-
 // full catalogs
 catalog_t	nvss_full;
 catalog_t	sdss_full;
@@ -54,6 +54,102 @@ catalog_t	sdss_B;
 catalog_t	nvss_A;
 catalog_t	nvss_B;
 
+// B of an earlier division, pinned as control of the tests
+catalog_t	nvss_control;
+
+// random galaxies in the SDSS footprint
+catalog_t	sdss_random;
+
+// sky pixelization order of the random catalogs
+int		hpx_order = HPX_DEFAULT_ORDER;
+
+// last serial handed to a cleared catalog
+unsigned int	catSerial;
+
+// catdata_t member behind each column
+const size_t	catFieldOffs[CF_NUMFIELDS] = {
+	offsetof( catdata_t, ra ),
+	offsetof( catdata_t, dec ),
+	offsetof( catdata_t, z ),
+	offsetof( catdata_t, abs_petro_r_mag ),
+	offsetof( catdata_t, u_b_color ),
+	offsetof( catdata_t, stellar_mass ),
+	offsetof( catdata_t, longitude ),
+	offsetof( catdata_t, latitude ),
+	offsetof( catdata_t, rot_measure ),
+	offsetof( catdata_t, rot_measure_err ),
+	offsetof( catdata_t, flux ),
+	offsetof( catdata_t, rot_measure_mean ),
+	offsetof( catdata_t, rot_measure_delta ),
+	offsetof( catdata_t, sourcesNum ),
+	offsetof( catdata_t, rot_measure_var ),
+	offsetof( catdata_t, rot_measure_mean_nn ),
+	offsetof( catdata_t, rot_measure_delta_nn ),
+	offsetof( catdata_t, rot_measure_sd_nn ),
+	offsetof( catdata_t, rot_measure_median ),
+	offsetof( catdata_t, rot_measure_median_delta ),
+	offsetof( catdata_t, near_impact ),
+	offsetof( catdata_t, near_index ),
+	offsetof( catdata_t, near_z ),
+	offsetof( catdata_t, near_mass ),
+	offsetof( catdata_t, near_ubcolor ),
+	offsetof( catdata_t, comovD ),
+	offsetof( catdata_t, angDiamD ),
+	offsetof( catdata_t, mollw_angle ),
+	offsetof( catdata_t, mollw_angle_gal ),
+	offsetof( catdata_t, cosdec ),
+	offsetof( catdata_t, vec[0] ),
+	offsetof( catdata_t, vec[1] ),
+	offsetof( catdata_t, vec[2] )
+};
+
+// ASCII files each catalog is made from
+const char	*sdssSources[] = { SDSS_FILE, COMOVD_FILE, NULL };
+const char	*nvssSources[] = { NVSS_FILE, NULL };
+
+
+/*
+================
+MEM_SchemaHash
+
+FNV-1a hash of the catdata_t layout, stored in binary caches
+================
+*/
+unsigned int	MEM_SchemaHash( void ) {
+	unsigned int	hash;
+	size_t		layout[CF_NUMFIELDS+2];
+	unsigned char	*p;
+	size_t		i;
+
+	layout[0] = sizeof(catdata_t);
+	layout[1] = CF_NUMFIELDS;
+	for ( i=0; i<CF_NUMFIELDS; i++ )
+		layout[i+2] = catFieldOffs[i];
+
+	hash = 2166136261u;
+	p = (unsigned char*)layout;
+	for ( i=0; i<sizeof(layout); i++ ) {
+		hash ^= p[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+/*
+================
+MEM_CatSources
+
+NULL terminated list of the files a catalog is read from
+================
+*/
+const char**	MEM_CatSources( cattype_t type ) {
+
+	if ( type == CT_NVSS )
+		return nvssSources;
+
+	return sdssSources;
+}
 
 /*
 ================
@@ -71,65 +167,356 @@ catdata_t*	MEM_AllocCatData( int n ) {
 
 /*
 ================
-MEM_CopyCat
+MEM_AllocAligned
+
+Allocate cache line aligned memory, release with free()
+================
+*/
+void*	MEM_AllocAligned( size_t size ) {
+	void *ptr;
+
+	if ( posix_memalign( &ptr, CAT_ALIGN, size ? size : CAT_ALIGN ) != 0 )
+		return NULL;
+	return ptr;
+}
+
+/*
+================
+MEM_IsResult
+
+1 for the fields ma, mn and a write, which selections keep themselves
+================
+*/
+int	MEM_IsResult( catfield_t field ) {
+
+	return field >= CF_RMMEAN && field <= CF_LASTRESULT;
+}
+
+/*
+================
+MEM_RowIndex
+
+Row of the full catalog behind row i of a selection
+================
+*/
+int	MEM_RowIndex( const catalog_t *sel, int i ) {
+
+	if ( sel->index == NULL )
+		return i;
+	return sel->index[i];
+}
+
+/*
+================
+MEM_Row
+
+Row i of a full catalog or a selection
+================
+*/
+const catdata_t*	MEM_Row( const catalog_t *cat, int i ) {
+
+	if ( cat->base != NULL )
+		return cat->base->data + MEM_RowIndex( cat, i );
+	return cat->data + i;
+}
+
+/*
+================
+MEM_RowValue
+
+One field of a row as double
+================
+*/
+double	MEM_RowValue( const catdata_t *cd, catfield_t field ) {
+
+	if ( field == CF_SOURCESNUM )
+		return cd->sourcesNum;
+	return *(const double*)((const char*)cd + catFieldOffs[field]);
+}
+
+/*
+================
+MEM_ResultColumn
+
+Writable result column of a selection, zero until ma/mn fill it.
+It has room for capacity rows and grows with MEM_Reserve.
+================
+*/
+double*	MEM_ResultColumn( catalog_t *cat, catfield_t field ) {
+	double *col;
+
+	if ( cat->cols == NULL )
+		cat->cols = calloc( 1, sizeof(catcols_t) );
+	if ( cat->cols->col[field] )
+		return cat->cols->col[field];
+
+	col = MEM_AllocAligned( cat->capacity * sizeof(double) );
+	memset( col, 0, cat->capacity * sizeof(double) );
+	cat->cols->col[field] = col;
+
+	return col;
+}
+
+/*
+================
+MEM_Reserve
 
-Copy catalog
+Make room for n rows in a selection, growing geometrically
 ================
 */
-void	MEM_CopyCat( catalog_t *from, catalog_t *to ) {
-	int size;
-	catdata_t *dat;
+void	MEM_Reserve( catalog_t *sel, int n ) {
+	int	size;
+	int	i, f;
+
+	if ( sel->index != NULL && n <= sel->capacity )
+		return;
+
+	size = 2 * sel->capacity;
+	if ( size < n )
+		size = n;
 
-	// copy cat data
-	size = from->number * sizeof(catdata_t);
-	memcpy( to->data, from->data, size );
-	// temporarily store data pointer
-	dat = to->data;
-	// copy whole catalog
-	memcpy( to, from, sizeof(catalog_t) );
-	// restore pointer
-	to->data = dat;
+	if ( sel->index == NULL ) {
+		// all rows so far, write them out
+		sel->index = malloc( size * sizeof(int) );
+		for ( i=0; i<sel->number; i++ )
+			sel->index[i] = i;
+	}
+	else
+		sel->index = realloc( sel->index, size * sizeof(int) );
+
+	if ( sel->cols != NULL )
+		for ( f=CF_RMMEAN; f<=CF_LASTRESULT; f++ ) {
+			double *col;
+
+			if ( sel->cols->col[f] == NULL )
+				continue;
+			col = MEM_AllocAligned( size * sizeof(double) );
+			memcpy( col, sel->cols->col[f],
+						sel->number * sizeof(double) );
+			memset( col + sel->number, 0,
+				(size - sel->number) * sizeof(double) );
+			free( sel->cols->col[f] );
+			sel->cols->col[f] = col;
+		}
+	sel->capacity = size;
 }
 
 /*
 ================
-MEM_CloneCatA
+MEM_Column
 
-clone catalog type and allocate buffer
+Contiguous column of one field of a catalog. Columns are gathered
+from the rows on first use and stay valid until MEM_DropColumns.
+Result columns of a selection are its data and may be written.
+Not thread safe: fetch all columns before starting workers.
 ================
 */
-void	MEM_CloneCatA( catalog_t *old, catalog_t *new ) {
+double*	MEM_Column( catalog_t *cat, catfield_t field ) {
+	catcols_t	*cols;
+	double		*col, *from;
+	int		i;
+
+	if ( cat->base != NULL && MEM_IsResult( field ) )
+		return MEM_ResultColumn( cat, field );
+
+	if ( cat->cols == NULL )
+		cat->cols = calloc( 1, sizeof(catcols_t) );
+	cols = cat->cols;
+
+	if ( cols->number != cat->number )
+		MEM_DropColumns( cat );
+	cols->number = cat->number;
+
+	if ( cols->col[field] )
+		return cols->col[field];
+
+	col = MEM_AllocAligned( cat->number * sizeof(double) );
+	if ( cat->base != NULL ) {
+		// pick from the full catalog's column
+		from = MEM_Column( cat->base, field );
+		for ( i=0; i<cat->number; i++ )
+			col[i] = from[MEM_RowIndex( cat, i )];
+	}
+	else
+		for ( i=0; i<cat->number; i++ )
+			col[i] = MEM_RowValue( cat->data+i, field );
+	cols->col[field] = col;
 
-	new->data = MEM_AllocCatData( old->number );
-	MEM_CopyCat( old, new );
+	return col;
 }
 
 /*
 ================
-MEM_CloneCatB
+MEM_DropColumns
 
-clone catalog type and allocate buffer + copy data
+Forget the columnar copy after the rows changed
 ================
 */
-void	MEM_CloneCatB( catalog_t *old, catalog_t *new ) {
+void	MEM_DropColumns( catalog_t *cat ) {
+	int f;
+
+	if ( cat->cols == NULL )
+		return;
 
-	new->data = MEM_AllocCatData( old->number );
-	new->type = old->type;
+	for ( f=0; f<CF_NUMFIELDS; f++ ) {
+		// a selection's results are no copy
+		if ( cat->base != NULL && MEM_IsResult( f ) )
+			continue;
+		free( cat->cols->col[f] );
+		cat->cols->col[f] = NULL;
+	}
+}
+
+/*
+================
+MEM_ClearCat
+
+Empty a catalog before appending to it
+================
+*/
+void	MEM_ClearCat( catalog_t *cat ) {
+	int f;
+
+	MEM_DropColumns( cat );
+	cat->number = 0;
+	// results computed against these rows are stale now
+	cat->serial = ++catSerial;
+	memset( &cat->near, 0, sizeof(catnear_t) );
+	// without an index there is no room to reuse
+	if ( cat->index == NULL )
+		cat->capacity = 0;
+	if ( cat->cols == NULL )
+		return;
+
+	for ( f=CF_RMMEAN; f<=CF_LASTRESULT; f++ ) {
+		free( cat->cols->col[f] );
+		cat->cols->col[f] = NULL;
+	}
+}
+
+/*
+================
+MEM_CopyRows
+
+Write out the rows of a catalog with a selection's results
+================
+*/
+void	MEM_CopyRows( catalog_t *cat, catdata_t *rows ) {
+	int i, f;
+
+	for ( i=0; i<cat->number; i++ )
+		rows[i] = *MEM_Row( cat, i );
+	if ( cat->base == NULL || cat->cols == NULL )
+		return;
+
+	for ( f=CF_RMMEAN; f<=CF_LASTRESULT; f++ ) {
+		double *col;
+
+		col = cat->cols->col[f];
+		if ( col == NULL )
+			continue;
+		for ( i=0; i<cat->number; i++ )
+			if ( f == CF_SOURCESNUM )
+				rows[i].sourcesNum = col[i];
+			else
+				*(double*)((char*)(rows+i) + catFieldOffs[f]) = col[i];
+	}
+}
+
+/*
+================
+MEM_ReleaseCat
+
+Empty a selection and give its memory back
+================
+*/
+void	MEM_ReleaseCat( catalog_t *sel ) {
+
+	MEM_ClearCat( sel );
+	free( sel->index );
+	sel->index = NULL;
+	sel->capacity = 0;
+}
+
+/*
+================
+MEM_InitSelection
+
+Make an empty selection of the rows of a full catalog.
+Nothing is allocated until rows are appended.
+================
+*/
+void	MEM_InitSelection( catalog_t *base, catalog_t *sel ) {
+
+	memset( sel, 0, sizeof(catalog_t) );
+	sel->type = base->type;
+	sel->base = base;
+}
+
+/*
+================
+MEM_SelectAll
+
+Select every row of the full catalog, without results
+================
+*/
+void	MEM_SelectAll( catalog_t *sel ) {
+
+	MEM_ReleaseCat( sel );
+	sel->number = sel->base->number;
+	sel->capacity = sel->number;
+	sel->threshold = sel->base->threshold;
 }
 
 /*
 ================
 MEM_AppendCat
 
-Append cat data from old catalog at offset to new catalog
+Append row offs of the old selection to the new one
 ================
 */
 void	MEM_AppendCat( catalog_t *old, catalog_t *new, int offs ) {
-
-	memcpy( new->data + new->number, old->data + offs, sizeof(catdata_t) );
+	int f;
+
+	MEM_Reserve( new, new->number+1 );
+	new->index[new->number] = MEM_RowIndex( old, offs );
+	// results follow the row
+	if ( old->cols != NULL )
+		for ( f=CF_RMMEAN; f<=CF_LASTRESULT; f++ )
+			if ( old->cols->col[f] )
+				MEM_ResultColumn( new, f )[new->number]
+							= old->cols->col[f][offs];
 	new->number++;
 }
 
+/*
+================
+MEM_GatherCat
+
+Append the rows of old whose mark equals value to new, in catalog
+order. Returns the number of rows appended.
+================
+*/
+int	MEM_GatherCat( catalog_t *old, catalog_t *new,
+				const unsigned char *mark, int value ) {
+	int i;
+	int start;
+	int count;
+
+	// exactly the room needed
+	count = 0;
+	for ( i=0; i<old->number; i++ )
+		count += mark[i] == value;
+	MEM_Reserve( new, new->number + count );
+
+	start = new->number;
+	for ( i=0; i<old->number; i++ )
+		if ( mark[i] == value )
+			MEM_AppendCat( old, new, i );
+
+	return new->number - start;
+}
+
 /*
 ================
 MEM_SwitchSDSSBuffer
@@ -171,29 +558,22 @@ void	MEM_GrabCatFile( catalog_t *cat ) {
 
 	switch ( cat->type ) {
 		case CT_SDSS:
-		FIO_OpenDataFile( &fp, "./data/SDSS_galaxies.dat", cat );
-		break;
+		// galaxies and distances have to match line by line
+		if ( FIO_LoadSDSS( cat ) == -1 ) {
+			printf( "Cannot continue with broken SDSS data.\n" );
+			exit( EXIT_FAILURE );
+		}
+		printf( "--------------------------------\n" );
+		return;
 		case CT_NVSS:
-		FIO_OpenDataFile( &fp, "./data/RMCatalogue.txt", cat );
+		// an empty catalog would be cached as up to date
+		if ( FIO_LoadNVSS( cat ) != 1 ) {
+			printf( "Cannot continue with broken NVSS data.\n" );
+			exit( EXIT_FAILURE );
+		}
 		break;
 	}
 
-	printf( "found %i sources.\n", cat->number );
-	
-	if ( cat->number == 0 )
-		return;
-
-	// allocate buffer for data;
-	cat->data = MEM_AllocCatData( cat->number );
-	if ( cat->data ) {
-		printf( "allocated %i cat sets for data.\n", cat->number );
-		FIO_ReadCatFile( fp, cat );
-	}
-	else
-		printf("allocation failed for %i cat data sets.\n",cat->number);
-
-	FIO_CloseFile( fp );
-
 	printf( "--------------------------------\n" );
 }
 
@@ -216,6 +596,8 @@ void	MEM_ProcessCatData( catalog_t *cat ) {
 		MAT_Mollweide( cd->dec, &cd->mollw_angle );
 		// calculate cos(dec)
 		cd->cosdec = cos(RAD*cd->dec);
+		// unit vector for all angular distance tests
+		MAT_UnitVector( cd->ra, cd->dec, cd->vec );
 	}
 	// Mollweide angle in Galactic coordinates
 	if ( cat->type == CT_NVSS ) {
@@ -240,14 +622,16 @@ void	MEM_LoadCulled( void ) {
 	int err;
 
 	// see if there is already a culled SDSS catalog
-	err = FIO_FileToMemory("/dev/shm/skyplot/SDSS_culled.dat",sdss_culled);
+	err = FIO_CacheToSelection( "/dev/shm/skyplot/SDSS_culled.dat",
+						sdss_culled, sdssSources );
 	if ( err == 0 ) {
 		printf( "loading culled SDSS failed.\n" );
 		return;
 	}
 
 	// also see if there is already a culled NVSS catalog
-	err = FIO_FileToMemory("/dev/shm/skyplot/NVSS_culled.dat",nvss_culled);
+	err = FIO_CacheToSelection( "/dev/shm/skyplot/NVSS_culled.dat",
+						nvss_culled, nvssSources );
 	if ( err == 0 ) {
 		printf( "loading culled NVSS failed.\n" );
 		return;
@@ -267,8 +651,11 @@ save culled catalogs for later
 */
 void	MEM_SaveCulled( void ) {
 
-	FIO_MemoryToFile( "/dev/shm/skyplot/SDSS_culled.dat", sdss_culled );
-	FIO_MemoryToFile( "/dev/shm/skyplot/NVSS_culled.dat", nvss_culled );
+	if ( FIO_MemoryToCache( "/dev/shm/skyplot/SDSS_culled.dat",
+					sdss_culled, sdssSources ) == 0
+		|| FIO_MemoryToCache( "/dev/shm/skyplot/NVSS_culled.dat",
+					nvss_culled, nvssSources ) == 0 )
+		return;
 
 	printf( "saved.\n");
 }
@@ -282,12 +669,121 @@ reset culled catalog
 */
 void	MEM_ResetCulled( void ) {
 
-	MEM_CopyCat( &sdss_full, sdss_culled );
-	MEM_CopyCat( &nvss_full, nvss_culled );
+	MEM_SelectAll( sdss_culled );
+	MEM_SelectAll( nvss_culled );
+
+	// the other culling buffers are refilled before they are read
+	MEM_ReleaseCat( sdss_culled == &sdss_culled1 ? &sdss_culled2
+							: &sdss_culled1 );
+	MEM_ReleaseCat( nvss_culled == &nvss_culled1 ? &nvss_culled2
+							: &nvss_culled1 );
 
 	printf( "catalogs reset.\n" );
 }
 
+/*
+================
+MEM_PrintCatUsage
+
+one line of the mem table, returns the bytes held
+================
+*/
+size_t	MEM_PrintCatUsage( const char *name, const catalog_t *cat ) {
+	size_t	rows, index, cols;
+	int	f;
+
+	rows = 0;
+	if ( cat->data != NULL )
+		rows = cat->map ? cat->mapSize
+				: (size_t)cat->number * sizeof(catdata_t);
+	index = cat->index ? (size_t)cat->capacity * sizeof(int) : 0;
+
+	cols = 0;
+	if ( cat->cols != NULL )
+		for ( f=0; f<CF_NUMFIELDS; f++ ) {
+			if ( cat->cols->col[f] == NULL )
+				continue;
+			if ( cat->base != NULL && MEM_IsResult( f ) )
+				cols += (size_t)cat->capacity * sizeof(double);
+			else
+				cols += (size_t)cat->cols->number * sizeof(double);
+		}
+
+	printf( "%-14s %9i %9i %10.1f%c %10.1f %10.1f\n", name, cat->number,
+			cat->base ? cat->capacity : cat->number, rows/1024.0,
+			cat->map ? '*' : ' ', index/1024.0, cols/1024.0 );
+
+	return rows + index + cols;
+}
+
+/*
+================
+MEM_PrintUsage
+
+Memory held by each catalog buffer and by the process
+================
+*/
+void	MEM_PrintUsage( void ) {
+	size_t		total;
+	long		pages, resident;
+	struct rusage	usage;
+	FILE		*statm;
+
+	printf( "%-14s %9s %9s %11s %10s %10s\n", "buffer", "sources",
+			"room", "rows kB", "index kB", "columns kB" );
+	total = 0;
+	total += MEM_PrintCatUsage( "NVSS full", &nvss_full );
+	total += MEM_PrintCatUsage( "SDSS full", &sdss_full );
+	total += MEM_PrintCatUsage( "NVSS culled 1", &nvss_culled1 );
+	total += MEM_PrintCatUsage( "NVSS culled 2", &nvss_culled2 );
+	total += MEM_PrintCatUsage( "SDSS culled 1", &sdss_culled1 );
+	total += MEM_PrintCatUsage( "SDSS culled 2", &sdss_culled2 );
+	total += MEM_PrintCatUsage( "NVSS A", &nvss_A );
+	total += MEM_PrintCatUsage( "NVSS B", &nvss_B );
+	total += MEM_PrintCatUsage( "NVSS control", &nvss_control );
+	total += MEM_PrintCatUsage( "SDSS A", &sdss_A );
+	total += MEM_PrintCatUsage( "SDSS B", &sdss_B );
+	total += MEM_PrintCatUsage( "SDSS random", &sdss_random );
+
+	printf( "total: %.1f kB (* mapped from /dev/shm/skyplot)\n",
+							total/1024.0 );
+
+	// what the process really holds
+	statm = fopen( "/proc/self/statm", "rt" );
+	if ( statm != NULL ) {
+		if ( fscanf( statm, "%li %li", &pages, &resident ) == 2 )
+			printf( "resident: %.1f kB", resident
+					* (double)sysconf( _SC_PAGESIZE ) / 1024 );
+		fclose( statm );
+	}
+	if ( getrusage( RUSAGE_SELF, &usage ) == 0 )
+		printf( ", peak: %li kB", usage.ru_maxrss );
+	printf( "\n" );
+}
+
+/*
+================
+MEM_SetPixelOrder
+
+set the sky pixelization order, or print the current one
+================
+*/
+void	MEM_SetPixelOrder( const char *cmdLine ) {
+	int order;
+
+	if ( sscanf( cmdLine, "%i", &order ) != 1 )
+		order = hpx_order;
+	if ( order < 0 || order > HPX_MAX_MAPORDER ) {
+		printf( "Pixel order must be between 0 and %i.\n",
+							HPX_MAX_MAPORDER );
+		return;
+	}
+	hpx_order = order;
+
+	printf( "Pixel order %i: %i pixels, max. radius %.3lf deg.\n", hpx_order,
+			HPX_NumPix(hpx_order), DEG*HPX_MaxPixRad(hpx_order) );
+}
+
 /*
 ================
 MEM_Init
@@ -302,48 +798,51 @@ void	MEM_Init( void ) {
 	sdss_culled = &sdss_culled1;
 	nvss_culled = &nvss_culled1;
 
-	// Try to read previous data file from RAM
-	if ( FIO_FileToMemory("/dev/shm/skyplot/NVSS.dat", &nvss_full) == 0 ) {
+	// Try to map previous data file from RAM
+	if ( FIO_CacheToMemory( "/dev/shm/skyplot/NVSS.dat", &nvss_full,
+						nvssSources ) == 0 ) {
 		// Read data from hard disk
 		nvss_full.type = CT_NVSS;
 		MEM_GrabCatFile( &nvss_full );
 		MEM_ProcessCatData( &nvss_full );
 
-		// Save data file to RAM
-		FIO_MemoryToFile( "/dev/shm/skyplot/NVSS.dat", &nvss_full );
+		// Save data file to RAM and share it from there
+		if ( FIO_MemoryToCache( "/dev/shm/skyplot/NVSS.dat", &nvss_full,
+							nvssSources ) == 1 )
+			FIO_CacheToMemory( "/dev/shm/skyplot/NVSS.dat",
+						&nvss_full, nvssSources );
 	}
 
-	// Try to read previous data file from RAM
-	if ( FIO_FileToMemory("/dev/shm/skyplot/SDSS.dat", &sdss_full) == 0 ) {
-		int lines;
-		// Read data from hard disk
+	// Try to map previous data file from RAM
+	if ( FIO_CacheToMemory( "/dev/shm/skyplot/SDSS.dat", &sdss_full,
+						sdssSources ) == 0 ) {
+		// Read data from hard disk, with the separate distance data
 		sdss_full.type = CT_SDSS;
 		MEM_GrabCatFile( &sdss_full );
 		MEM_ProcessCatData( &sdss_full );
 
-		// workaround for separate distance data
-		lines = FIO_OpenDataFile( &fp, "./data/comovD.dat", NULL );
-		if ( lines != sdss_full.number )
-			printf( "SDSS line mismatch.\n" );
-		FIO_ReadDistFile( fp, &sdss_full );
-		FIO_CloseFile( fp );
-
-		// Save data file to RAM
-		FIO_MemoryToFile( "/dev/shm/skyplot/SDSS.dat", &sdss_full );
+		// Save data file to RAM and share it from there
+		if ( FIO_MemoryToCache( "/dev/shm/skyplot/SDSS.dat", &sdss_full,
+							sdssSources ) == 1 )
+			FIO_CacheToMemory( "/dev/shm/skyplot/SDSS.dat",
+						&sdss_full, sdssSources );
 	}
 
-	// allocate space for primary buffer and copy full catalog
-	MEM_CloneCatA( &sdss_full, &sdss_culled1 );
-	MEM_CloneCatA( &nvss_full, &nvss_culled1 );
-
-	// allocate space for seconday buffers too
-	MEM_CloneCatB( &sdss_full, &sdss_culled2 );
-	MEM_CloneCatB( &nvss_full, &nvss_culled2 );
-	// and for statistical probes
-	MEM_CloneCatB( &sdss_full, &sdss_A );
-	MEM_CloneCatB( &sdss_full, &sdss_B );
-	MEM_CloneCatB( &nvss_full, &nvss_A );
-	MEM_CloneCatB( &nvss_full, &nvss_B );
+	// culled buffers select rows of the full catalogs, all at first
+	MEM_InitSelection( &sdss_full, &sdss_culled1 );
+	MEM_InitSelection( &nvss_full, &nvss_culled1 );
+	MEM_SelectAll( &sdss_culled1 );
+	MEM_SelectAll( &nvss_culled1 );
+
+	// seconday buffers too, allocated when first used
+	MEM_InitSelection( &sdss_full, &sdss_culled2 );
+	MEM_InitSelection( &nvss_full, &nvss_culled2 );
+	// and statistical probes
+	MEM_InitSelection( &sdss_full, &sdss_A );
+	MEM_InitSelection( &sdss_full, &sdss_B );
+	MEM_InitSelection( &nvss_full, &nvss_A );
+	MEM_InitSelection( &nvss_full, &nvss_B );
+	MEM_InitSelection( &nvss_full, &nvss_control );
 
 	printf( "----------------------------------------" );
 	printf( "----------------------------------------\n" );
@@ -358,7 +857,16 @@ Free an allocated data buffer
 */
 void	MEM_FreeDataBuffer( catalog_t *cat ) {
 
-	free( cat->data );
+	MEM_ClearCat( cat );
+	free( cat->cols );
+	cat->cols = NULL;
+	free( cat->index );
+	cat->index = NULL;
+	if ( cat->map != NULL )
+		FIO_ReleaseCache( cat );
+	else
+		free( cat->data );
+	cat->data = NULL;
 }
 
 /*
@@ -380,5 +888,7 @@ void	MEM_FreeAllBuffers( void ) {
 	MEM_FreeDataBuffer( &sdss_B );
 	MEM_FreeDataBuffer( &nvss_A );
 	MEM_FreeDataBuffer( &nvss_B );
+	MEM_FreeDataBuffer( &nvss_control );
+	MEM_FreeDataBuffer( &sdss_random );
 }
 
@@ -0,0 +1,296 @@
+/*
+* pairs.c - table of all NVSS-SDSS pairs
+*
+* Copyright (C) 2012 Michael Rieder <mr@student.ethz.ch>
+*
+* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or (at
+* your option) any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+*
+* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*/
+
+
+#include <limits.h>
+#include "skyplot.h"
+
+/*
+* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+* VARIABLES
+* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*/
+
+pairtable_t	pairTable;
+
+typedef struct pairjob_s {
+	xmatch_t	xm;
+	catalog_t	*nvss;
+	catalog_t	*sdss;
+	pairtable_t	*pt;
+	int		fill;		// 0 counts, 1 writes the pairs
+	int		completed;
+	time_t		tic;
+} pairjob_t;
+
+
+/*
+================
+PAIR_Compare
+
+qsort callback: by impact parameter, then by SDSS row
+================
+*/
+int	PAIR_Compare( const void *a, const void *b ) {
+	const xmpair_t *pa = a;
+	const xmpair_t *pb = b;
+
+	if ( pa->impact < pb->impact )
+		return -1;
+	if ( pa->impact > pb->impact )
+		return 1;
+	return pa->gal - pb->gal;
+}
+
+/*
+================
+PAIR_Free
+
+Empty a pair table
+================
+*/
+void	PAIR_Free( pairtable_t *pt ) {
+
+	if ( pt->map != NULL )
+		FIO_ReleasePairs( pt );
+	else {
+		free( pt->start );
+		free( pt->pairs );
+		free( pt->nvssDone );
+		free( pt->sdssDone );
+	}
+	memset( pt, 0, sizeof(pairtable_t) );
+}
+
+/*
+================
+PAIR_BuildChunk
+
+Worker job: count or write the pairs of the NVSS sources [start,end).
+Each source owns its row of the table.
+================
+*/
+void	PAIR_BuildChunk( void *arg, int start, int end, int worker ) {
+	pairjob_t	*job;
+	pairtable_t	*pt;
+	int		i;
+
+	job = arg;
+	pt = job->pt;
+	for ( i=start; i<end; i++ ) {
+		const catdata_t	*cdn;
+		xmpair_t	*pairs;
+		int		row, k, num;
+
+		cdn = MEM_Row( job->nvss, i );
+		row = MEM_RowIndex( job->nvss, i );
+		if ( job->fill == 0 ) {
+			pt->start[row+1] = XM_Pairs( &job->xm, cdn, NULL );
+			continue;
+		}
+
+		pairs = pt->pairs + pt->start[row];
+		num = XM_Pairs( &job->xm, cdn, pairs );
+		for ( k=0; k<num; k++ )
+			pairs[k].gal = MEM_RowIndex( job->sdss, pairs[k].gal );
+		qsort( pairs, num, sizeof(xmpair_t), PAIR_Compare );
+	}
+
+	if ( job->fill )
+		THR_Progress( &job->completed, end-start, job->nvss->number,
+								job->tic );
+}
+
+/*
+================
+PAIR_Build
+
+All pairs of culled NVSS sources and culled SDSS galaxies below an
+impact parameter, as rows of the full catalogs
+================
+*/
+void	PAIR_Build( const char *cmdLine ) {
+	pairtable_t	*pt;
+	pairjob_t	job;
+	thrjob_t	thrJob;
+	long long	total;
+	int		i;
+
+	memset( &job, 0, sizeof(pairjob_t) );
+	job.nvss = nvss_culled;
+	job.sdss = sdss_culled;
+	pt = &pairTable;
+
+	PAIR_Free( pt );
+	pt->radius = PAIR_DEFAULT_RADIUS;
+	sscanf( cmdLine, "%lf", &pt->radius );
+	if ( pt->radius <= 0 ) {
+		printf( "Radius must be positive.\n" );
+		pt->radius = 0;
+		return;
+	}
+	printf( "Pairs of %i NVSS and %i SDSS up to %lf Kiloparsecs...\n",
+		job.nvss->number, job.sdss->number, pt->radius );
+
+	pt->numNVSS = nvss_full.number;
+	pt->numSDSS = sdss_full.number;
+	pt->start = calloc( pt->numNVSS+1, sizeof(int) );
+	pt->nvssDone = calloc( pt->numNVSS+1, 1 );
+	pt->sdssDone = calloc( pt->numSDSS+1, 1 );
+	for ( i=0; i<job.nvss->number; i++ )
+		pt->nvssDone[MEM_RowIndex( job.nvss, i )] = 1;
+	for ( i=0; i<job.sdss->number; i++ )
+		pt->sdssDone[MEM_RowIndex( job.sdss, i )] = 1;
+
+	XM_Build( &job.xm, job.sdss, pt->radius );
+	job.pt = pt;
+
+	// count the pairs of each row
+	memset( &thrJob, 0, sizeof(thrjob_t) );
+	thrJob.func = PAIR_BuildChunk;
+	thrJob.arg = &job;
+	thrJob.number = job.nvss->number;
+	THR_Run( &thrJob );
+
+	total = 0;
+	for ( i=0; i<pt->numNVSS; i++ )
+		total += pt->start[i+1];
+	if ( total > INT_MAX ) {
+		printf( "%lli pairs are too many, use a smaller radius.\n",
+								total );
+		XM_Free( &job.xm );
+		PAIR_Free( pt );
+		return;
+	}
+	for ( i=0; i<pt->numNVSS; i++ )
+		pt->start[i+1] += pt->start[i];
+	pt->numPairs = total;
+	pt->pairs = malloc( (total+1) * sizeof(xmpair_t) );
+	memset( pt->pairs, 0, (total+1) * sizeof(xmpair_t) );
+
+	// then write them
+	job.fill = 1;
+	time( &job.tic );
+	memset( &thrJob, 0, sizeof(thrjob_t) );
+	thrJob.func = PAIR_BuildChunk;
+	thrJob.arg = &job;
+	thrJob.number = job.nvss->number;
+	THR_Run( &thrJob );
+	printf( "\n" );
+	XM_Free( &job.xm );
+
+	printf( "%i pairs, %.1f kB.\n", pt->numPairs,
+				pt->numPairs * sizeof(xmpair_t) / 1024.0 );
+	if ( FIO_PairsToCache( PAIR_FILE, pt ) )
+		printf( "saved to %s.\n", PAIR_FILE );
+}
+
+/*
+================
+PAIR_Marks
+
+Sort the NVSS sources by the pair table instead of a cross-match:
+a source is a hit if one of its pairs within threshold, by the dot
+product cut of XM_Reaches, is a galaxy of sdss. Returns 0 if the
+table does not cover the catalogs.
+================
+*/
+int	PAIR_Marks( catalog_t *nvss, catalog_t *sdss, double threshold,
+						unsigned char *mark ) {
+	pairtable_t	*pt;
+	unsigned char	*member;
+	int		i;
+
+	pt = &pairTable;
+	if ( pt->radius <= 0 || threshold > pt->radius
+		|| nvss->base != &nvss_full || sdss->base != &sdss_full
+		|| pt->numNVSS != nvss_full.number
+		|| pt->numSDSS != sdss_full.number )
+		return 0;
+
+	// every source and galaxy has to be in the table
+	for ( i=0; i<nvss->number; i++ )
+		if ( pt->nvssDone[MEM_RowIndex( nvss, i )] == 0 )
+			return 0;
+	member = calloc( pt->numSDSS+1, 1 );
+	for ( i=0; i<sdss->number; i++ ) {
+		int row = MEM_RowIndex( sdss, i );
+
+		if ( pt->sdssDone[row] == 0 ) {
+			free( member );
+			return 0;
+		}
+		member[row] = 1;
+	}
+
+	// join the rows with the membership of their galaxies
+	for ( i=0; i<nvss->number; i++ ) {
+		int row, p;
+
+		row = MEM_RowIndex( nvss, i );
+		mark[i] = THR_MARK_MISS;
+		for ( p=pt->start[row]; p<pt->start[row+1]; p++ ) {
+			int gal = pt->pairs[p].gal;
+
+			// sorted by impact, the cut can only differ by rounding
+			if ( pt->pairs[p].impact > threshold * (1 + XM_IMPACT_PAD) )
+				break;
+			if ( member[gal] && XM_Reaches( sdss_full.data + gal,
+					nvss_full.data[row].vec, threshold ) ) {
+				mark[i] = THR_MARK_HIT;
+				break;
+			}
+		}
+	}
+	free( member );
+
+	printf( "Joined with %i pairs up to %lf Kiloparsecs.\n",
+					pt->numPairs, pt->radius );
+	return 1;
+}
+
+/*
+================
+PAIR_Command
+
+Pair table commands: 'x [radius]' builds and saves it,
+'xl' maps the saved one
+================
+*/
+void	PAIR_Command( const char *cmdLine ) {
+
+	if ( CUL_CullBusy() || STAT_DivideBusy() ) {
+		printf( "NVSS culling or division still running.\n" );
+		return;
+	}
+
+	if ( cmdLine[0] == 'l' ) {
+		PAIR_Free( &pairTable );
+		if ( FIO_CacheToPairs( PAIR_FILE, &pairTable ) )
+			printf( "mapped %i pairs up to %lf Kiloparsecs.\n",
+				pairTable.numPairs, pairTable.radius );
+		return;
+	}
+	PAIR_Build( cmdLine );
+}
@@ -0,0 +1,222 @@
+/*
+* random.c - random catalogs in the SDSS footprint
+*
+* Copyright (C) 2012 Michael Rieder <mr@student.ethz.ch>
+*
+* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or (at
+* your option) any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+*
+* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*/
+
+
+#include "skyplot.h"
+
+typedef struct rndjob_s {
+	catalog_t	*from;		// galaxies the footprint comes from
+	catalog_t	*to;
+	int		order;		// pixel order of the mask
+	int		numPix;
+	int		*pix;		// occupied pixels
+	double		reach;		// cap covering any pixel (rad)
+	unsigned long long seed;
+	int		completed;
+	time_t		tic;
+} rndjob_t;
+
+
+/*
+================
+RND_Uniform
+
+uniform double in (0,1)
+================
+*/
+double	RND_Uniform( sigrng_t *rng ) {
+
+	return (SIG_RngNext( rng ) + 0.5) / 4294967296.0;
+}
+
+/*
+================
+RND_InPixel
+
+Uniform unit vector inside a pixel: points uniform in a cap around
+the pixel center until one falls into the pixel
+================
+*/
+void	RND_InPixel( sigrng_t *rng, int order, int pix, double reach,
+							double *vec ) {
+	double	c[3], e1[3], e2[3];
+	double	cosReach, len;
+
+	HPX_Pix2Vec( order, pix, c );
+	// two directions perpendicular to the center
+	if ( fabs( c[2] ) < 0.9 ) {
+		e1[0] = -c[1];
+		e1[1] = c[0];
+		e1[2] = 0;
+	}
+	else {
+		e1[0] = 0;
+		e1[1] = c[2];
+		e1[2] = -c[1];
+	}
+	len = sqrt( MAT_Dot( e1, e1 ) );
+	e1[0] /= len;
+	e1[1] /= len;
+	e1[2] /= len;
+	e2[0] = c[1]*e1[2] - c[2]*e1[1];
+	e2[1] = c[2]*e1[0] - c[0]*e1[2];
+	e2[2] = c[0]*e1[1] - c[1]*e1[0];
+
+	cosReach = cos( reach );
+	do {
+		double	cost, sint, phi;
+		int	k;
+
+		cost = 1 - RND_Uniform( rng ) * (1 - cosReach);
+		sint = sqrt( 1 - cost*cost );
+		phi = 2*M_PI * RND_Uniform( rng );
+		for ( k=0; k<3; k++ )
+			vec[k] = cost*c[k] + sint*(cos(phi)*e1[k]
+							+ sin(phi)*e2[k]);
+	} while ( HPX_Vec2Pix( order, vec ) != pix );
+}
+
+/*
+================
+RND_Chunk
+
+Worker job: random galaxies [start,end). Each takes z and the
+other galaxy properties from a random real galaxy and its position
+from a random occupied pixel. Every row has its own random stream.
+================
+*/
+void	RND_Chunk( void *arg, int start, int end, int worker ) {
+	rndjob_t	*job;
+	int		i;
+
+	job = arg;
+	for ( i=start; i<end; i++ ) {
+		catdata_t	*cd;
+		sigrng_t	rng;
+		double		vec[3];
+		int		pix;
+
+		SIG_RngSeed( &rng, job->seed, SIG_STREAM_RAND, i );
+		cd = job->to->data + i;
+		*cd = *MEM_Row( job->from,
+				SIG_RngBelow( &rng, job->from->number ) );
+
+		pix = job->pix[SIG_RngBelow( &rng, job->numPix )];
+		RND_InPixel( &rng, job->order, pix, job->reach, vec );
+		cd->ra = DEG*atan2( vec[1], vec[0] );
+		if ( cd->ra < 0 )
+			cd->ra += 360;
+		cd->dec = DEG*asin( vec[2] );
+
+		// same derived values as loaded galaxies
+		MAT_Mollweide( cd->dec, &cd->mollw_angle );
+		cd->cosdec = cos(RAD*cd->dec);
+		MAT_UnitVector( cd->ra, cd->dec, cd->vec );
+	}
+
+	THR_Progress( &job->completed, end-start, job->to->number, job->tic );
+}
+
+/*
+================
+RND_SDSSRandom
+
+Random galaxies in the footprint of the culled SDSS, with its
+redshift distribution: 'dg [factor] [seed]'. They become SDSS A,
+so that dn divides the NVSS by the random foreground. dsX selects
+from the real galaxies again.
+================
+*/
+void	RND_SDSSRandom( const char *cmdLine ) {
+	double		factor;
+	unsigned long long seed;
+	catalog_t	*sdss;
+	rndjob_t	job;
+	thrjob_t	thrJob;
+	unsigned char	*occupied;
+	int		*pix;
+	int		i, npix, number;
+
+	factor = RND_DEFAULT_FACTOR;
+	seed = 1;
+	sscanf( cmdLine, "%lf %llu", &factor, &seed );
+
+	sdss = sdss_culled;
+	number = factor * sdss->number;
+	if ( number < 1 ) {
+		printf( "No random galaxies for factor %lf.\n", factor );
+		return;
+	}
+	if ( STAT_DivideBusy() ) {
+		printf( "NVSS division still running.\n" );
+		return;
+	}
+
+	// footprint: pixels holding a galaxy
+	npix = HPX_NumPix( hpx_order );
+	pix = malloc( (sdss->number+1) * sizeof(int) );
+	HPX_CatalogPix( hpx_order, sdss, 0, pix );
+	occupied = calloc( npix, 1 );
+	for ( i=0; i<sdss->number; i++ )
+		occupied[pix[i]] = 1;
+	memset( &job, 0, sizeof(rndjob_t) );
+	for ( i=0; i<npix; i++ )
+		if ( occupied[i] )
+			pix[job.numPix++] = i;
+	free( occupied );
+
+	printf( "Generating %i random galaxies in %i pixels of order %i...\n",
+						number, job.numPix, hpx_order );
+
+	// A must not point into the old rows
+	MEM_FreeDataBuffer( &sdss_A );
+	MEM_ClearCat( &sdss_B );
+	MEM_FreeDataBuffer( &sdss_random );
+	sdss_random.type = CT_SDSS;
+	sdss_random.data = MEM_AllocCatData( number );
+	sdss_random.number = number;
+
+	job.from = sdss;
+	job.to = &sdss_random;
+	job.order = hpx_order;
+	job.pix = pix;
+	job.reach = HPX_MaxPixRad( hpx_order ) * (1 + RND_REACH_PAD);
+	job.seed = seed;
+	time( &job.tic );
+
+	memset( &thrJob, 0, sizeof(thrjob_t) );
+	thrJob.func = RND_Chunk;
+	thrJob.arg = &job;
+	thrJob.number = number;
+	THR_Run( &thrJob );
+	printf( "\n" );
+	free( pix );
+
+	// the randoms are the foreground for dn now
+	if ( sdss_A.base != &sdss_random )
+		MEM_InitSelection( &sdss_random, &sdss_A );
+	MEM_SelectAll( &sdss_A );
+	printf( "SDSS A: %i random galaxies (%.1lf times %i).\n",
+				sdss_A.number, factor, sdss->number );
+}
@@ -0,0 +1,1383 @@
+/*
+* significance.c - two-sample tests of the A and B bins
+*
+* Copyright (C) 2012 Michael Rieder <mr@student.ethz.ch>
+*
+* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or (at
+* your option) any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+*
+* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*/
+
+#include "skyplot.h"
+
+/*
+* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+* VARIABLES
+* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*/
+
+// p-values of this session, printed by tp
+sigrow_t	*sigTable;
+int		sigRows;
+int		sigSize;
+
+
+/*
+================
+SIG_CompareDouble
+
+qsort comparison of doubles
+================
+*/
+int	SIG_CompareDouble( const void *a, const void *b ) {
+	double da, db;
+
+	da = *(const double*)a;
+	db = *(const double*)b;
+	if ( da < db )
+		return -1;
+	if ( da > db )
+		return 1;
+	return 0;
+}
+
+/*
+================
+SIG_SortedAbs
+
+Sorted absolute values of a column, release with free(). Rows without
+a value (NAN) are left out and num is reduced to the ones kept.
+================
+*/
+double*	SIG_SortedAbs( const double *col, int *num ) {
+	double	*sorted;
+	int	i, kept;
+
+	sorted = malloc( (*num+1) * sizeof(double) );
+	kept = 0;
+	for ( i=0; i<*num; i++ )
+		if ( !isnan( col[i] ) )
+			sorted[kept++] = fabs( col[i] );
+	qsort( sorted, kept, sizeof(double), SIG_CompareDouble );
+	*num = kept;
+
+	return sorted;
+}
+
+/*
+================
+SIG_Defined
+
+Copy of the rows of a column that have a value, release with free().
+num is reduced to the rows kept.
+================
+*/
+double*	SIG_Defined( const double *col, int *num ) {
+	double	*defined;
+	int	i, kept;
+
+	defined = malloc( (*num+1) * sizeof(double) );
+	kept = 0;
+	for ( i=0; i<*num; i++ )
+		if ( !isnan( col[i] ) )
+			defined[kept++] = col[i];
+	*num = kept;
+
+	return defined;
+}
+
+/*
+================
+SIG_CompareKey
+
+qsort comparison of sort keys, ties by index
+================
+*/
+int	SIG_CompareKey( const void *a, const void *b ) {
+	const sigsort_t *ka, *kb;
+
+	ka = a;
+	kb = b;
+	if ( ka->key < kb->key )
+		return -1;
+	if ( ka->key > kb->key )
+		return 1;
+	return ka->index - kb->index;
+}
+
+/*
+================
+SIG_SortOrderAbs
+
+Indices of a column in order of absolute value, release with free().
+Rows without a value (NAN) are left out and num is reduced to the
+ones kept.
+================
+*/
+int*	SIG_SortOrderAbs( const double *col, int *num ) {
+	sigsort_t	*sorted;
+	int		*order;
+	int		i, kept;
+
+	sorted = malloc( (*num+1) * sizeof(sigsort_t) );
+	kept = 0;
+	for ( i=0; i<*num; i++ ) {
+		if ( isnan( col[i] ) )
+			continue;
+		sorted[kept].key = fabs( col[i] );
+		sorted[kept].index = i;
+		kept++;
+	}
+	qsort( sorted, kept, sizeof(sigsort_t), SIG_CompareKey );
+	*num = kept;
+
+	order = malloc( (kept+1) * sizeof(int) );
+	for ( i=0; i<kept; i++ )
+		order[i] = sorted[i].index;
+	free( sorted );
+
+	return order;
+}
+
+/*
+================
+SIG_StdDev
+
+sample standard deviation
+================
+*/
+double	SIG_StdDev( const double *x, int num ) {
+	double	mean, sum;
+	int	i;
+
+	if ( num < 2 )
+		return 0;
+	mean = 0;
+	for ( i=0; i<num; i++ )
+		mean += x[i];
+	mean /= num;
+	sum = 0;
+	for ( i=0; i<num; i++ )
+		sum += (x[i] - mean) * (x[i] - mean);
+
+	return sqrt( sum / (num - 1) );
+}
+
+/*
+================
+SIG_NextGroup
+
+Advance both sorted samples past the next smallest value.
+fa and fb get how often it occurs in a and b.
+================
+*/
+void	SIG_NextGroup( const double *a, int na, int *i,
+			const double *b, int nb, int *j, int *fa, int *fb ) {
+	double v;
+
+	if ( *i < na && (*j >= nb || a[*i] <= b[*j]) )
+		v = a[*i];
+	else
+		v = b[*j];
+
+	*fa = 0;
+	while ( *i < na && a[*i] == v ) {
+		(*i)++;
+		(*fa)++;
+	}
+	*fb = 0;
+	while ( *j < nb && b[*j] == v ) {
+		(*j)++;
+		(*fb)++;
+	}
+}
+
+/*
+================
+SIG_PSmirnov2x
+
+Exact P(D < d) of the two-sample Smirnov statistic without ties,
+as in R's ks.test
+================
+*/
+double	SIG_PSmirnov2x( double d, int m, int n ) {
+	double	md, nd, q, w;
+	double	*u;
+	double	p;
+	int	i, j;
+
+	if ( m > n ) {
+		i = n;
+		n = m;
+		m = i;
+	}
+	md = m;
+	nd = n;
+	q = (0.5 + floor( d * md * nd - 1e-7 )) / (md * nd);
+	u = malloc( (n+1) * sizeof(double) );
+
+	for ( j=0; j<=n; j++ )
+		u[j] = (j / nd > q) ? 0 : 1;
+	for ( i=1; i<=m; i++ ) {
+		w = (double)i / (i + n);
+		if ( i / md > q )
+			u[0] = 0;
+		else
+			u[0] = w * u[0];
+		for ( j=1; j<=n; j++ ) {
+			if ( fabs( i / md - j / nd ) > q )
+				u[j] = 0;
+			else
+				u[j] = w * u[j] + u[j-1];
+		}
+	}
+	p = u[n];
+	free( u );
+
+	return p;
+}
+
+/*
+================
+SIG_PKolmogorov
+
+Limiting distribution P(K <= x) of sqrt(n) D
+================
+*/
+double	SIG_PKolmogorov( double x ) {
+	double	s, z, w, old, new;
+	int	k, kmax;
+
+	if ( x <= 0 )
+		return 0;
+
+	kmax = (int)sqrt( 2 - log( SIG_KS_TOL ) );
+	if ( x < 1 ) {
+		z = -(M_PI_2 * M_PI_4) / (x * x);
+		w = log( x );
+		s = 0;
+		for ( k=1; k<kmax; k+=2 )
+			s += exp( k * k * z - w );
+		return s / (1 / sqrt( 2*M_PI ));
+	}
+
+	z = -2 * x * x;
+	s = -1;
+	k = 1;
+	old = 0;
+	new = 1;
+	while ( fabs( old - new ) > SIG_KS_TOL ) {
+		old = new;
+		new += 2 * s * exp( z * k * k );
+		s *= -1;
+		k++;
+	}
+	return new;
+}
+
+/*
+================
+SIG_KSTest
+
+Two-sample Kolmogorov-Smirnov test of sorted samples, in one merge.
+Exact for small samples without ties, asymptotic otherwise.
+Returns the p-value, d gets the statistic.
+================
+*/
+double	SIG_KSTest( const double *a, int na, const double *b, int nb,
+								double *d ) {
+	int	i, j, fa, fb;
+	int	ties;
+	double	p, n;
+
+	*d = 0;
+	ties = 0;
+	i = j = 0;
+	while ( i < na && j < nb ) {
+		double diff;
+
+		SIG_NextGroup( a, na, &i, b, nb, &j, &fa, &fb );
+		if ( fa + fb > 1 )
+			ties = 1;
+		diff = fabs( (double)i/na - (double)j/nb );
+		if ( diff > *d )
+			*d = diff;
+	}
+	// the rest only closes the gap, but may still hold ties
+	for ( ; i+1 < na; i++ )
+		if ( a[i] == a[i+1] )
+			ties = 1;
+	for ( ; j+1 < nb; j++ )
+		if ( b[j] == b[j+1] )
+			ties = 1;
+
+	if ( (double)na * nb < SIG_KS_EXACT && ties == 0 )
+		p = 1 - SIG_PSmirnov2x( *d, na, nb );
+	else {
+		n = (double)na * nb / (na + nb);
+		p = 1 - SIG_PKolmogorov( sqrt( n ) * *d );
+	}
+
+	if ( p < 0 )
+		return 0;
+	if ( p > 1 )
+		return 1;
+	return p;
+}
+
+/*
+================
+SIG_ADTest
+
+Two-sample Anderson-Darling test of sorted samples (Scholz and
+Stephens 1987, midrank version for ties) in one merge. The p-value
+is interpolated from their table and limited to [0.001,0.25].
+Returns the p-value, a2 gets the standardized statistic.
+================
+*/
+double	SIG_ADTest( const double *a, int na, const double *b, int nb,
+								double *a2 ) {
+	static const double	b0[7] = { 0.675, 1.281, 1.645, 1.96, 2.326,
+							2.573, 3.085 };
+	static const double	b1[7] = { -0.245, 0.25, 0.678, 1.149, 1.822,
+							2.364, 3.615 };
+	static const double	b2[7] = { -0.105, -0.305, -0.362, -0.391,
+						-0.396, -0.345, -0.154 };
+	static const double	sig[7] = { 0.25, 0.1, 0.05, 0.025, 0.01,
+							0.005, 0.001 };
+	double	crit[7];
+	double	N, H, h, g, hs, sigmasq;
+	double	sumA, sumB, akn;
+	double	sx[5], sy[3], det, c0, c1, c2;
+	int	i, j, fa, fb, t;
+
+	N = na + nb;
+	*a2 = 0;
+	if ( na < 1 || nb < 1 || N < 4 )
+		return 1;
+
+	sumA = sumB = 0;
+	i = j = 0;
+	while ( i < na || j < nb ) {
+		double	lj, bj, ma, mb, den;
+		int	ca, cb;
+
+		ca = i;
+		cb = j;
+		SIG_NextGroup( a, na, &i, b, nb, &j, &fa, &fb );
+		lj = fa + fb;
+		bj = ca + cb + lj/2;
+		den = bj * (N - bj) - N * lj / 4;
+		if ( den <= 0 )
+			continue;
+		ma = ca + fa/2.0;
+		mb = cb + fb/2.0;
+		sumA += lj / N * (N*ma - bj*na) * (N*ma - bj*na) / den;
+		sumB += lj / N * (N*mb - bj*nb) * (N*mb - bj*nb) / den;
+	}
+	akn = (N - 1) / N * (sumA / na + sumB / nb);
+
+	// variance of the statistic for k = 2 samples
+	H = 1.0/na + 1.0/nb;
+	hs = 0;
+	g = 0;
+	for ( t=N-1; t>=2; t-- ) {
+		hs += 1.0 / t;
+		g += hs / (N - t + 1);
+	}
+	h = hs + 1;
+	sigmasq = ( ((4*g - 6) + (10 - 6*g)*H) * N*N*N
+		+ ((2*g - 4)*4 + 16*h + (2*g - 14*h - 4)*H - 8*h + 4*g - 6) * N*N
+		+ ((6*h + 2*g - 2)*4 + (4*h - 4*g + 6)*2 + (2*h - 6)*H + 4*h) * N
+		+ ((2*h + 6)*4 - 8*h) ) / ((N - 1) * (N - 2) * (N - 3));
+	*a2 = (akn - 1) / sqrt( sigmasq );
+
+	// quadratic fit of log(sig) over the critical values
+	for ( i=0; i<7; i++ )
+		crit[i] = b0[i] + b1[i] + b2[i];
+	if ( *a2 <= crit[0] )
+		return sig[0];
+	if ( *a2 >= crit[6] )
+		return sig[6];
+
+	memset( sx, 0, sizeof(sx) );
+	memset( sy, 0, sizeof(sy) );
+	for ( i=0; i<7; i++ ) {
+		double x = 1, y = log( sig[i] );
+
+		for ( j=0; j<5; j++ ) {
+			sx[j] += x;
+			if ( j < 3 )
+				sy[j] += x * y;
+			x *= crit[i];
+		}
+	}
+	// Cramer's rule for [sx0 sx1 sx2; sx1 sx2 sx3; sx2 sx3 sx4] c = sy
+	det = sx[0]*(sx[2]*sx[4] - sx[3]*sx[3])
+		- sx[1]*(sx[1]*sx[4] - sx[3]*sx[2])
+		+ sx[2]*(sx[1]*sx[3] - sx[2]*sx[2]);
+	c0 = ( sy[0]*(sx[2]*sx[4] - sx[3]*sx[3])
+		- sx[1]*(sy[1]*sx[4] - sx[3]*sy[2])
+		+ sx[2]*(sy[1]*sx[3] - sx[2]*sy[2]) ) / det;
+	c1 = ( sx[0]*(sy[1]*sx[4] - sx[3]*sy[2])
+		- sy[0]*(sx[1]*sx[4] - sx[3]*sx[2])
+		+ sx[2]*(sx[1]*sy[2] - sy[1]*sx[2]) ) / det;
+	c2 = ( sx[0]*(sx[2]*sy[2] - sy[1]*sx[3])
+		- sx[1]*(sx[1]*sy[2] - sy[1]*sx[2])
+		+ sy[0]*(sx[1]*sx[3] - sx[2]*sx[2]) ) / det;
+
+	return exp( c0 + c1 * *a2 + c2 * *a2 * *a2 );
+}
+
+/*
+================
+SIG_MWTest
+
+Two-sided Mann-Whitney U test of sorted samples with midranks,
+normal approximation with tie and continuity correction as in R's
+wilcox.test. Returns the p-value, u gets U of sample a.
+================
+*/
+double	SIG_MWTest( const double *a, int na, const double *b, int nb,
+								double *u ) {
+	double	N, rankA, ties, rank0, z, sigma;
+	int	i, j, fa, fb;
+
+	N = na + nb;
+	rankA = 0;
+	ties = 0;
+	rank0 = 0;
+	i = j = 0;
+	while ( i < na || j < nb ) {
+		double t;
+
+		SIG_NextGroup( a, na, &i, b, nb, &j, &fa, &fb );
+		t = fa + fb;
+		rankA += fa * (rank0 + (t + 1) / 2);
+		ties += t*t*t - t;
+		rank0 += t;
+	}
+	*u = rankA - (double)na * (na + 1) / 2;
+
+	if ( na < 1 || nb < 1 )
+		return 1;
+	sigma = sqrt( (double)na * nb / 12
+			* ((N + 1) - ties / (N * (N - 1))) );
+	if ( sigma == 0 )
+		return 1;
+
+	z = *u - (double)na * nb / 2;
+	if ( z > 0 )
+		z -= 0.5;
+	else if ( z < 0 )
+		z += 0.5;
+	z /= sigma;
+
+	return erfc( fabs( z ) / sqrt( 2 ) );
+}
+
+/*
+================
+SIG_Philox
+
+Philox4x32-10 block: four random words for a counter and key
+================
+*/
+void	SIG_Philox( const unsigned int *ctr, const unsigned int *key,
+							unsigned int *out ) {
+	unsigned int		c[4], k[2];
+	unsigned long long	p0, p1;
+	int			r;
+
+	memcpy( c, ctr, sizeof(c) );
+	k[0] = key[0];
+	k[1] = key[1];
+	for ( r=0; r<10; r++ ) {
+		p0 = 0xD2511F53ull * c[0];
+		p1 = 0xCD9E8D57ull * c[2];
+		c[0] = (unsigned int)(p1 >> 32) ^ c[1] ^ k[0];
+		c[1] = (unsigned int)p1;
+		c[2] = (unsigned int)(p0 >> 32) ^ c[3] ^ k[1];
+		c[3] = (unsigned int)p0;
+		k[0] += 0x9E3779B9u;
+		k[1] += 0xBB67AE85u;
+	}
+	memcpy( out, c, sizeof(c) );
+}
+
+/*
+================
+SIG_RngSeed
+
+Start the random stream of one replicate. Streams only depend on
+seed, kind and replicate, not on the worker that draws them.
+================
+*/
+void	SIG_RngSeed( sigrng_t *rng, unsigned long long seed, int kind,
+							int replicate ) {
+
+	rng->key[0] = (unsigned int)seed;
+	rng->key[1] = (unsigned int)(seed >> 32);
+	rng->ctr[0] = 0;
+	rng->ctr[1] = 0;
+	rng->ctr[2] = kind;
+	rng->ctr[3] = replicate;
+	rng->used = 4;
+}
+
+/*
+================
+SIG_RngNext
+
+next 32 random bits
+================
+*/
+unsigned int	SIG_RngNext( sigrng_t *rng ) {
+
+	if ( rng->used == 4 ) {
+		SIG_Philox( rng->ctr, rng->key, rng->out );
+		if ( ++rng->ctr[0] == 0 )
+			rng->ctr[1]++;
+		rng->used = 0;
+	}
+	return rng->out[rng->used++];
+}
+
+/*
+================
+SIG_RngBelow
+
+uniform integer in [0,n), without modulo bias
+================
+*/
+int	SIG_RngBelow( sigrng_t *rng, int n ) {
+	unsigned long long	m;
+	unsigned int		limit;
+
+	m = (unsigned long long)SIG_RngNext( rng ) * n;
+	if ( (unsigned int)m < (unsigned int)n ) {
+		limit = -(unsigned int)n % (unsigned int)n;
+		while ( (unsigned int)m < limit )
+			m = (unsigned long long)SIG_RngNext( rng ) * n;
+	}
+	return m >> 32;
+}
+
+/*
+================
+SIG_LabeledKS
+
+KS statistic of the pooled sorted values, label 1 for sample a
+================
+*/
+double	SIG_LabeledKS( const double *v, const unsigned char *label, int num,
+							int na, int nb ) {
+	double	d;
+	int	i, ca, cb;
+
+	d = 0;
+	ca = cb = 0;
+	for ( i=0; i<num; ) {
+		double	diff;
+		double	value;
+
+		// whole group of equal values at once
+		value = v[i];
+		for ( ; i<num && v[i] == value; i++ ) {
+			ca += label[i];
+			cb += !label[i];
+		}
+		diff = fabs( (double)ca/na - (double)cb/nb );
+		if ( diff > d )
+			d = diff;
+	}
+	return d;
+}
+
+typedef struct sigjob_s {
+	int		numA, numB, num;
+	int		numReplicates;
+	double		*sortedAbs;	// pooled |x|, sorted
+	double		*value;		// pooled x in the same order
+	double		*colA, *colB;	// x of A and of B with a value
+	unsigned long long seed;
+	int		completed;
+	time_t		tic;
+
+	int		**perm;		// per worker
+	unsigned char	**label;	// per worker
+	double		*nullD;		// per replicate
+	double		*nullMean;
+	double		*boot;
+} sigjob_t;
+
+/*
+================
+SIG_ResampleChunk
+
+Worker job: replicates [start,end) of the permutation null and
+the bootstrap, O(n) each
+================
+*/
+void	SIG_ResampleChunk( void *arg, int start, int end, int worker ) {
+	sigjob_t	*job;
+	int		*perm;
+	unsigned char	*label;
+	int		r;
+
+	job = arg;
+	perm = job->perm[worker];
+	label = job->label[worker];
+
+	for ( r=start; r<end; r++ ) {
+		sigrng_t	rng;
+		double		sumA, sumB;
+		int		i, k;
+
+		// random relabeling into groups of |A| and |B|
+		SIG_RngSeed( &rng, job->seed, SIG_STREAM_PERM, r );
+		for ( i=0; i<job->num; i++ )
+			perm[i] = i;
+		memset( label, 0, job->num );
+		sumA = 0;
+		for ( i=0; i<job->numA; i++ ) {
+			int tmp;
+
+			k = i + SIG_RngBelow( &rng, job->num - i );
+			tmp = perm[k];
+			perm[k] = perm[i];
+			perm[i] = tmp;
+			label[tmp] = 1;
+			sumA += job->value[tmp];
+		}
+		sumB = 0;
+		for ( ; i<job->num; i++ )
+			sumB += job->value[perm[i]];
+		job->nullD[r] = SIG_LabeledKS( job->sortedAbs, label, job->num,
+						job->numA, job->numB );
+		job->nullMean[r] = sumA/job->numA - sumB/job->numB;
+
+		// bootstrap: both bins drawn with replacement
+		SIG_RngSeed( &rng, job->seed, SIG_STREAM_BOOT, r );
+		sumA = 0;
+		for ( i=0; i<job->numA; i++ )
+			sumA += job->colA[SIG_RngBelow( &rng, job->numA )];
+		sumB = 0;
+		for ( i=0; i<job->numB; i++ )
+			sumB += job->colB[SIG_RngBelow( &rng, job->numB )];
+		job->boot[r] = sumA/job->numA - sumB/job->numB;
+	}
+
+	THR_Progress( &job->completed, end-start, job->numReplicates,
+								job->tic );
+}
+
+/*
+================
+SIG_Quantile
+
+quantile p of sorted data, linear interpolation (R type 7)
+================
+*/
+double	SIG_Quantile( const double *sorted, int num, double p ) {
+	double	h;
+	int	lo;
+
+	h = (num - 1) * p;
+	lo = (int)floor( h );
+	if ( lo >= num - 1 )
+		return sorted[num-1];
+	return sorted[lo] + (h - lo) * (sorted[lo+1] - sorted[lo]);
+}
+
+/*
+================
+SIG_Histogram
+
+Print a text histogram, the bin holding mark is flagged
+================
+*/
+void	SIG_Histogram( const char *title, const double *x, int num,
+								double mark ) {
+	int	count[SIG_HIST_BINS];
+	double	lo, hi, width;
+	int	i, most;
+
+	lo = hi = x[0];
+	for ( i=1; i<num; i++ ) {
+		if ( x[i] < lo )
+			lo = x[i];
+		if ( x[i] > hi )
+			hi = x[i];
+	}
+	if ( mark < lo )
+		lo = mark;
+	if ( mark > hi )
+		hi = mark;
+	width = (hi - lo) / SIG_HIST_BINS;
+	if ( width <= 0 )
+		width = 1;
+
+	memset( count, 0, sizeof(count) );
+	for ( i=0; i<num; i++ ) {
+		int b = (x[i] - lo) / width;
+
+		count[b < SIG_HIST_BINS ? b : SIG_HIST_BINS-1]++;
+	}
+	most = 1;
+	for ( i=0; i<SIG_HIST_BINS; i++ )
+		if ( count[i] > most )
+			most = count[i];
+
+	printf( "%s:\n", title );
+	for ( i=0; i<SIG_HIST_BINS; i++ ) {
+		int	k, bars;
+		int	marked;
+
+		marked = mark >= lo + i*width && (mark < lo + (i+1)*width
+					|| i == SIG_HIST_BINS-1);
+		bars = count[i] * SIG_HIST_WIDTH / most;
+		printf( "%12.6lf %7i %c ", lo + (i+0.5)*width, count[i],
+						marked ? '>' : '|' );
+		for ( k=0; k<bars; k++ )
+			putchar( '#' );
+		putchar( '\n' );
+	}
+}
+
+/*
+================
+SIG_Resample
+
+Permutation null and bootstrap of the A/B split of column x on
+all cores: 'b<x> [replicates] [seed]'
+================
+*/
+void	SIG_Resample( const char *cmdLine ) {
+	char		dataType;
+	catfield_t	field;
+	int		numReplicates;
+	unsigned long long seed;
+	sigjob_t	job;
+	thrjob_t	thrJob;
+	int		*order;
+	unsigned char	*label;
+	double		*pooled, *boot;
+	double		obsD, obsMean;
+	int		i, numWorkers, extremeD, extremeMean;
+
+	dataType = cmdLine[0];
+	field = STAT_FieldOf( dataType );
+	if ( field == CF_NONE ) {
+		printf( "Unrecognized data type '%c'.\n", dataType );
+		return;
+	}
+	numReplicates = SIG_DEFAULT_REPLICATES;
+	seed = 1;
+	sscanf( cmdLine+1, "%i %llu", &numReplicates, &seed );
+	if ( numReplicates < 1 ) {
+		printf( "Need at least one replicate.\n" );
+		return;
+	}
+	if ( STAT_DivideBusy() ) {
+		printf( "NVSS division still running.\n" );
+		return;
+	}
+	if ( nvss_A.number < 1 || nvss_B.number < 1 ) {
+		printf( "Divide the NVSS into A and B first.\n" );
+		return;
+	}
+
+	memset( &job, 0, sizeof(sigjob_t) );
+	memset( &thrJob, 0, sizeof(thrjob_t) );
+	job.numA = nvss_A.number;
+	job.numB = nvss_B.number;
+	job.colA = SIG_Defined( MEM_Column( &nvss_A, field ), &job.numA );
+	job.colB = SIG_Defined( MEM_Column( &nvss_B, field ), &job.numB );
+	if ( job.numA < 1 || job.numB < 1 ) {
+		printf( "No %c values in NVSS A or B.\n", dataType );
+		free( job.colA );
+		free( job.colB );
+		return;
+	}
+	job.num = job.numA + job.numB;
+	job.numReplicates = numReplicates;
+	job.seed = seed;
+
+	printf( "Resampling %c of NVSS A (%i) vs. B (%i), %i replicates...\n",
+			dataType, job.numA, job.numB, numReplicates );
+
+	// one sorted copy of the pooled data for all replicates
+	pooled = malloc( job.num * sizeof(double) );
+	for ( i=0; i<job.numA; i++ )
+		pooled[i] = job.colA[i];
+	for ( i=0; i<job.numB; i++ )
+		pooled[job.numA+i] = job.colB[i];
+	order = SIG_SortOrderAbs( pooled, &job.num );
+	job.sortedAbs = malloc( job.num * sizeof(double) );
+	job.value = malloc( job.num * sizeof(double) );
+	label = malloc( job.num );
+	for ( i=0; i<job.num; i++ ) {
+		job.sortedAbs[i] = fabs( pooled[order[i]] );
+		job.value[i] = pooled[order[i]];
+		label[i] = order[i] < job.numA;
+	}
+	obsD = SIG_LabeledKS( job.sortedAbs, label, job.num,
+						job.numA, job.numB );
+	obsMean = 0;
+	for ( i=0; i<job.numA; i++ )
+		obsMean += job.colA[i];
+	obsMean /= job.numA;
+	for ( i=0; i<job.numB; i++ )
+		obsMean -= job.colB[i] / job.numB;
+	free( pooled );
+	free( order );
+	free( label );
+
+	// scratch space of each worker
+	numWorkers = THR_NumWorkers( 0 );
+	job.perm = malloc( numWorkers * sizeof(int*) );
+	job.label = malloc( numWorkers * sizeof(unsigned char*) );
+	for ( i=0; i<numWorkers; i++ ) {
+		job.perm[i] = malloc( job.num * sizeof(int) );
+		job.label[i] = malloc( job.num );
+	}
+	job.nullD = malloc( numReplicates * sizeof(double) );
+	job.nullMean = malloc( numReplicates * sizeof(double) );
+	job.boot = malloc( numReplicates * sizeof(double) );
+
+	time( &job.tic );
+	thrJob.func = SIG_ResampleChunk;
+	thrJob.arg = &job;
+	thrJob.number = numReplicates;
+	THR_Run( &thrJob );
+	printf( "\n" );
+
+	// empirical p-values, counting the observed split itself
+	extremeD = 0;
+	extremeMean = 0;
+	for ( i=0; i<numReplicates; i++ ) {
+		if ( job.nullD[i] >= obsD )
+			extremeD++;
+		if ( fabs( job.nullMean[i] ) >= fabs( obsMean ) )
+			extremeMean++;
+	}
+	boot = job.boot;
+	qsort( boot, numReplicates, sizeof(double), SIG_CompareDouble );
+
+	SIG_Histogram( "Permutation null of KS D on |x|", job.nullD,
+						numReplicates, obsD );
+	printf( "KS D = %lf, permutation p = %lg\n", obsD,
+			(extremeD + 1.0) / (numReplicates + 1) );
+	printf( "mean A - mean B = %lf, permutation p = %lg\n", obsMean,
+			(extremeMean + 1.0) / (numReplicates + 1) );
+	SIG_Histogram( "Bootstrap of mean A - mean B", boot,
+						numReplicates, obsMean );
+	printf( "bootstrap 95%% interval: [%lf, %lf], standard error %lf\n",
+			SIG_Quantile( boot, numReplicates, 0.025 ),
+			SIG_Quantile( boot, numReplicates, 0.975 ),
+			SIG_StdDev( boot, numReplicates ) );
+
+	for ( i=0; i<numWorkers; i++ ) {
+		free( job.perm[i] );
+		free( job.label[i] );
+	}
+	free( job.perm );
+	free( job.label );
+	free( job.sortedAbs );
+	free( job.value );
+	free( job.nullD );
+	free( job.nullMean );
+	free( job.boot );
+	free( job.colA );
+	free( job.colB );
+}
+
+typedef struct sigjack_s {
+	int		num;
+	int		numA, numB;
+	double		*sortedAbs;	// pooled |x|, sorted
+	unsigned char	*label;		// 1 for A
+	int		*region;	// region of each pooled entry
+	int		*regA, *regB;	// sources of A and B per region
+	double		*jackD;		// KS D without each region
+} sigjack_t;
+
+/*
+================
+SIG_JackknifeChunk
+
+Worker job: KS D of the pooled sorted data with the regions
+[start,end) left out in turn
+================
+*/
+void	SIG_JackknifeChunk( void *arg, int start, int end, int worker ) {
+	sigjack_t	*job;
+	int		k;
+
+	job = arg;
+	for ( k=start; k<end; k++ ) {
+		double	d;
+		int	i, ca, cb, na, nb;
+
+		na = job->numA - job->regA[k];
+		nb = job->numB - job->regB[k];
+		if ( na < 1 || nb < 1 ) {
+			job->jackD[k] = 0;
+			continue;
+		}
+		d = 0;
+		ca = cb = 0;
+		for ( i=0; i<job->num; ) {
+			double	diff;
+			double	value;
+
+			value = job->sortedAbs[i];
+			for ( ; i<job->num && job->sortedAbs[i] == value; i++ ) {
+				if ( job->region[i] == k )
+					continue;
+				ca += job->label[i];
+				cb += !job->label[i];
+			}
+			diff = fabs( (double)ca/na - (double)cb/nb );
+			if ( diff > d )
+				d = diff;
+		}
+		job->jackD[k] = d;
+	}
+}
+
+/*
+================
+SIG_JackknifeStats
+
+jackknife mean and variance of the delete-one values that exist
+================
+*/
+void	SIG_JackknifeStats( const char *name, double full, const double *x,
+			const unsigned char *valid, int numRegions ) {
+	double	mean, var;
+	int	k, n;
+
+	mean = 0;
+	n = 0;
+	for ( k=0; k<numRegions; k++ )
+		if ( valid[k] ) {
+			mean += x[k];
+			n++;
+		}
+	mean /= n;
+	var = 0;
+	for ( k=0; k<numRegions; k++ )
+		if ( valid[k] )
+			var += (x[k] - mean) * (x[k] - mean);
+	var *= (n - 1.0) / n;
+
+	printf( "%s: full %lf, jackknife mean %lf, variance %lg, "
+			"error %lf, bias-corrected %lf\n", name, full, mean,
+			var, sqrt( var ), n*full - (n-1)*mean );
+}
+
+/*
+================
+SIG_Jackknife
+
+Jackknife errors of the A/B split of column x over sky regions:
+'j<x> [regions]'. The sky covered by NVSS A and B is cut into
+regions holding the same number of occupied HEALPix pixels, taken
+in nested order so that each region stays compact. Every statistic
+with one region left out comes from per-region sums and one walk
+over the pooled sorted data; no cross-match is repeated.
+================
+*/
+void	SIG_Jackknife( const char *cmdLine ) {
+	char		dataType;
+	catfield_t	field;
+	int		numRegions;
+	sigjack_t	job;
+	thrjob_t	thrJob;
+	int		npix, numOcc;
+	int		*pixA, *pixB, *rank, *order;
+	double		*colA, *colB, *pooled;
+	double		*sumA, *sumB, *jackMean;
+	unsigned char	*valid;
+	double		allA, allB;
+	double		fullMean, fullD;
+	int		i, k, numValid, numA, numB;
+
+	dataType = cmdLine[0];
+	field = STAT_FieldOf( dataType );
+	if ( field == CF_NONE ) {
+		printf( "Unrecognized data type '%c'.\n", dataType );
+		return;
+	}
+	numRegions = SIG_JK_REGIONS;
+	sscanf( cmdLine+1, "%i", &numRegions );
+	if ( numRegions < 2 ) {
+		printf( "Need at least two regions.\n" );
+		return;
+	}
+	if ( STAT_DivideBusy() ) {
+		printf( "NVSS division still running.\n" );
+		return;
+	}
+	if ( nvss_A.number < 1 || nvss_B.number < 1 ) {
+		printf( "Divide the NVSS into A and B first.\n" );
+		return;
+	}
+
+	memset( &job, 0, sizeof(sigjack_t) );
+	job.numA = nvss_A.number;
+	job.numB = nvss_B.number;
+	job.num = job.numA + job.numB;
+
+	// occupied pixels of the footprint, ranked in nested order
+	npix = HPX_NumPix( SIG_JK_ORDER );
+	pixA = malloc( (job.numA+1) * sizeof(int) );
+	pixB = malloc( (job.numB+1) * sizeof(int) );
+	HPX_CatalogPix( SIG_JK_ORDER, &nvss_A, 0, pixA );
+	HPX_CatalogPix( SIG_JK_ORDER, &nvss_B, 0, pixB );
+	rank = calloc( npix, sizeof(int) );
+	for ( i=0; i<job.numA; i++ )
+		rank[pixA[i]] = 1;
+	for ( i=0; i<job.numB; i++ )
+		rank[pixB[i]] = 1;
+	numOcc = 0;
+	for ( i=0; i<npix; i++ )
+		if ( rank[i] )
+			rank[i] = numOcc++;
+		else
+			rank[i] = -1;
+	if ( numOcc < numRegions ) {
+		printf( "Only %i occupied pixels for %i regions.\n",
+						numOcc, numRegions );
+		free( pixA );
+		free( pixB );
+		free( rank );
+		return;
+	}
+
+	// per-region partial sums of the sources with a value
+	colA = MEM_Column( &nvss_A, field );
+	colB = MEM_Column( &nvss_B, field );
+	job.regA = calloc( numRegions, sizeof(int) );
+	job.regB = calloc( numRegions, sizeof(int) );
+	sumA = calloc( numRegions, sizeof(double) );
+	sumB = calloc( numRegions, sizeof(double) );
+	pooled = malloc( job.num * sizeof(double) );
+	job.region = malloc( job.num * sizeof(int) );
+	numA = 0;
+	for ( i=0; i<job.numA; i++ ) {
+		if ( isnan( colA[i] ) )
+			continue;
+		k = (long long)rank[pixA[i]] * numRegions / numOcc;
+		job.regA[k]++;
+		sumA[k] += fabs( colA[i] );
+		pooled[numA] = colA[i];
+		pixA[numA++] = k;
+	}
+	numB = 0;
+	for ( i=0; i<job.numB; i++ ) {
+		if ( isnan( colB[i] ) )
+			continue;
+		k = (long long)rank[pixB[i]] * numRegions / numOcc;
+		job.regB[k]++;
+		sumB[k] += fabs( colB[i] );
+		pooled[numA+numB] = colB[i];
+		pixB[numB++] = k;
+	}
+	free( rank );
+	job.numA = numA;
+	job.numB = numB;
+	job.num = numA + numB;
+	if ( numA < 1 || numB < 1 ) {
+		printf( "No %c values in NVSS A or B.\n", dataType );
+		free( pooled );
+		free( pixA );
+		free( pixB );
+		free( sumA );
+		free( sumB );
+		free( job.regA );
+		free( job.regB );
+		free( job.region );
+		return;
+	}
+
+	printf( "Jackknife of %c of NVSS A (%i) vs. B (%i), %i regions "
+			"of %i pixels...\n", dataType, job.numA, job.numB,
+			numRegions, numOcc / numRegions );
+
+	// one sorted copy of the pooled data for all regions
+	order = SIG_SortOrderAbs( pooled, &job.num );
+	job.sortedAbs = malloc( job.num * sizeof(double) );
+	job.label = malloc( job.num );
+	for ( i=0; i<job.num; i++ ) {
+		int src = order[i];
+
+		job.sortedAbs[i] = fabs( pooled[src] );
+		job.label[i] = src < job.numA;
+		job.region[i] = src < job.numA ? pixA[src]
+						: pixB[src-job.numA];
+	}
+	free( order );
+	free( pooled );
+	free( pixA );
+	free( pixB );
+
+	// full sample
+	fullD = SIG_LabeledKS( job.sortedAbs, job.label, job.num,
+						job.numA, job.numB );
+	allA = allB = 0;
+	for ( k=0; k<numRegions; k++ ) {
+		allA += sumA[k];
+		allB += sumB[k];
+	}
+	fullMean = allA / job.numA - allB / job.numB;
+
+	job.jackD = malloc( numRegions * sizeof(double) );
+	memset( &thrJob, 0, sizeof(thrjob_t) );
+	thrJob.func = SIG_JackknifeChunk;
+	thrJob.arg = &job;
+	thrJob.number = numRegions;
+	thrJob.grain = 1;
+	THR_Run( &thrJob );
+
+	// delete-one mean difference from the region sums
+	jackMean = malloc( numRegions * sizeof(double) );
+	valid = malloc( numRegions );
+	numValid = 0;
+	printf( "%7s %8s %8s %12s %12s\n", "region", "A", "B",
+						"A - B", "KS D" );
+	for ( k=0; k<numRegions; k++ ) {
+		int	na, nb;
+
+		na = job.numA - job.regA[k];
+		nb = job.numB - job.regB[k];
+		valid[k] = na > 0 && nb > 0;
+		if ( valid[k] == 0 ) {
+			printf( "%7i %8i %8i  holds all of A or B, skipped\n",
+					k, job.regA[k], job.regB[k] );
+			continue;
+		}
+		jackMean[k] = (allA - sumA[k]) / na - (allB - sumB[k]) / nb;
+		numValid++;
+		printf( "%7i %8i %8i %12.6lf %12.6lf\n", k, job.regA[k],
+				job.regB[k], jackMean[k], job.jackD[k] );
+	}
+
+	if ( numValid < 2 )
+		printf( "Too few regions left for a jackknife.\n" );
+	else {
+		SIG_JackknifeStats( "mean |x| A - B", fullMean, jackMean,
+							valid, numRegions );
+		SIG_JackknifeStats( "KS D on |x|", fullD, job.jackD,
+							valid, numRegions );
+	}
+
+	free( job.sortedAbs );
+	free( job.label );
+	free( job.region );
+	free( job.regA );
+	free( job.regB );
+	free( job.jackD );
+	free( sumA );
+	free( sumB );
+	free( jackMean );
+	free( valid );
+}
+
+/*
+================
+SIG_PinControl
+
+Keep a copy of the current NVSS B as control sample, so the A of
+later divisions is tested against it like kstest.r does
+================
+*/
+void	SIG_PinControl( void ) {
+	int i;
+
+	if ( STAT_DivideBusy() ) {
+		printf( "NVSS division still running.\n" );
+		return;
+	}
+	if ( nvss_B.number < 1 ) {
+		printf( "Divide the NVSS into A and B first.\n" );
+		return;
+	}
+
+	MEM_ClearCat( &nvss_control );
+	MEM_Reserve( &nvss_control, nvss_B.number );
+	for ( i=0; i<nvss_B.number; i++ )
+		MEM_AppendCat( &nvss_B, &nvss_control, i );
+	nvss_control.threshold = nvss_B.threshold;
+	nvss_control.near = nvss_B.near;
+	printf( "Pinned the %i sources of NVSS B as control.\n",
+						nvss_control.number );
+}
+
+/*
+================
+SIG_TestAB
+
+KS, AD and Mann-Whitney tests of |column| of NVSS A against B,
+or against the pinned control, like kstest.r. The p-values are
+added to the session table.
+================
+*/
+void	SIG_TestAB( const char *cmdLine ) {
+	char		dataType;
+	char		label[SIG_LABEL_LEN];
+	catfield_t	field;
+	double		*a, *b;
+	sigrow_t	*row;
+	catalog_t	*control;
+	const char	*controlName;
+
+	dataType = cmdLine[0];
+	field = STAT_FieldOf( dataType );
+	if ( field == CF_NONE ) {
+		printf( "Unrecognized data type '%c'.\n", dataType );
+		return;
+	}
+	if ( sscanf( cmdLine+1, "%31s", label ) != 1 )
+		snprintf( label, sizeof(label), "%c", dataType );
+
+	if ( STAT_DivideBusy() ) {
+		printf( "NVSS division still running.\n" );
+		return;
+	}
+	// B of this division, unless one was pinned
+	if ( nvss_control.number > 0 ) {
+		control = &nvss_control;
+		controlName = "control";
+	}
+	else {
+		control = &nvss_B;
+		controlName = "B";
+	}
+	if ( nvss_A.number < 1 || control->number < 1 ) {
+		printf( "Divide the NVSS into A and B first.\n" );
+		return;
+	}
+
+	if ( sigRows == sigSize ) {
+		sigSize = sigSize ? 2*sigSize : 16;
+		sigTable = realloc( sigTable, sigSize * sizeof(sigrow_t) );
+	}
+	row = sigTable + sigRows;
+	memset( row, 0, sizeof(sigrow_t) );
+	strcpy( row->label, label );
+	row->dataType = dataType;
+	row->numA = nvss_A.number;
+	row->numB = control->number;
+
+	a = SIG_SortedAbs( MEM_Column( &nvss_A, field ), &row->numA );
+	b = SIG_SortedAbs( MEM_Column( control, field ), &row->numB );
+	if ( row->numA < 1 || row->numB < 1 ) {
+		printf( "No %c values in NVSS A or %s.\n", dataType,
+							controlName );
+		free( a );
+		free( b );
+		return;
+	}
+	row->pKS = SIG_KSTest( a, row->numA, b, row->numB, &row->ks );
+	row->pAD = SIG_ADTest( a, row->numA, b, row->numB, &row->ad );
+	row->pMW = SIG_MWTest( a, row->numA, b, row->numB, &row->mw );
+	free( a );
+	free( b );
+	sigRows++;
+
+	printf( "|%c| of NVSS A (%i) vs. %s (%i):\n", dataType,
+				row->numA, controlName, row->numB );
+	printf( "Kolmogorov-Smirnov D = %lf, p = %lg\n", row->ks, row->pKS );
+	printf( "Anderson-Darling  A2 = %lf, p = %lg\n", row->ad, row->pAD );
+	printf( "Mann-Whitney       U = %.1lf, p = %lg\n", row->mw, row->pMW );
+}
+
+/*
+================
+SIG_PrintTable
+
+p-values of all tests so far
+================
+*/
+void	SIG_PrintTable( void ) {
+	int i;
+
+	printf( "%-20s %c %7s %7s %12s %12s %12s\n", "label", ' ',
+				"A", "B", "KS p", "AD p", "MW p" );
+	for ( i=0; i<sigRows; i++ ) {
+		sigrow_t *row = sigTable + i;
+
+		printf( "%-20s %c %7i %7i %12.6lg %12.6lg %12.6lg\n",
+				row->label, row->dataType, row->numA,
+				row->numB, row->pKS, row->pAD, row->pMW );
+	}
+}
+
+/*
+================
+SIG_Command
+
+Process two-sample test commands: t<x> [label] tests data type x,
+tt<p|w> prints or wipes the table, tt<c|r> pins the current B as
+control or releases it. 't' is no data type letter.
+================
+*/
+void	SIG_Command( const char *cmdLine ) {
+
+	if ( cmdLine[0] != 't' ) {
+		SIG_TestAB( cmdLine );
+		return;
+	}
+
+	switch ( cmdLine[1] ) {
+		case 'p':
+		SIG_PrintTable();
+		break;
+		case 'w':
+		sigRows = 0;
+		printf( "Test table wiped.\n" );
+		break;
+		case 'c':
+		SIG_PinControl();
+		break;
+		case 'r':
+		MEM_ReleaseCat( &nvss_control );
+		printf( "Testing against NVSS B again.\n" );
+		break;
+		default:
+		printf( "Unknown test table command '%c'.\n", cmdLine[1] );
+		break;
+	}
+}
+
+/*
+================
+SIG_Free
+
+Free the test table
+================
+*/
+void	SIG_Free( void ) {
+
+	free( sigTable );
+	sigTable = NULL;
+	sigRows = 0;
+	sigSize = 0;
+}
@@ -90,8 +90,12 @@ int	SKY_ExecCmd( const char *line ){
 		// Ignore this cmd
 		break;
 	case 'm':
-		// Compute mean RM
-		SKY_MeanRM( line+1 );
+		if ( strncmp( line, "mem", 3 ) == 0 )
+			// Memory footprint
+			MEM_PrintUsage();
+		else
+			// Compute mean RM
+			SKY_MeanRM( line+1 );
 		break;
 	case 'p':
 		// Draw the Plot
@@ -105,6 +109,10 @@ int	SKY_ExecCmd( const char *line ){
 		// load previous work
 		MEM_SaveCulled();
 		break;
+	case 'o':
+		// sky pixelization order
+		MEM_SetPixelOrder( line+1 );
+		break;
 	case 'r':
 		// reset culling
 		MEM_ResetCulled();
@@ -119,10 +127,30 @@ int	SKY_ExecCmd( const char *line ){
 		if ( STAT_DivideCancel(line+1) == 1 )
 			return 1;
 		break;
+	case 'a':
+		// Nearest galaxy of every NVSS source
+		XM_Annotate( line+1 );
+		break;
+	case 'x':
+		// Table of NVSS-SDSS pairs
+		PAIR_Command( line+1 );
+		break;
 	case 'w':
 		// Write data to disk for stat. analysis
 		STAT_WriteToDisk( line+1 );
 		break;
+	case 't':
+		// Two-sample tests of A and B
+		SIG_Command( line+1 );
+		break;
+	case 'b':
+		// Permutation null and bootstrap of A and B
+		SIG_Resample( line+1 );
+		break;
+	case 'j':
+		// Jackknife errors of A and B over sky regions
+		SIG_Jackknife( line+1 );
+		break;
 	case 'h':
 		// Print Help message
 		SKY_PrintHelp();
@@ -157,7 +185,7 @@ loop to read script cmds
 ================
 */
 void	SKY_ScriptLoop( const char *fileName ) {
-	char	cmdBuffer[64];
+	char	cmdBuffer[SKY_CMD_LEN];
 	int	n;
 	int	fin;
 
@@ -173,6 +201,17 @@ void	SKY_ScriptLoop( const char *fileName ) {
 		char		clocktime[16];
 
 		n++;
+		if ( strchr( cmdBuffer, '\n' ) == NULL
+			&& strlen( cmdBuffer ) == sizeof(cmdBuffer)-1 ) {
+			// never run the cut off head of a line
+			printf( "Script line %i is longer than %i characters, "
+					"skipped.\n", n, SKY_CMD_LEN-2 );
+			while ( strchr( cmdBuffer, '\n' ) == NULL
+				&& FIO_ReadScript( cmdBuffer,
+						sizeof(cmdBuffer) ) != 0 )
+				;
+			continue;
+		}
 		if ( cmdBuffer[0] == '#' || cmdBuffer[0] == '\n' )
 			continue;
 
@@ -210,7 +249,7 @@ loop to listen for commands
 ================
 */
 void	SKY_CmdLoop( void ) {
-	char lineBuffer[128];
+	char lineBuffer[SKY_CMD_LEN];
 
 	printf( "Interactive mode.\n" );
 	while ( 1 ) {
@@ -245,6 +284,7 @@ int	main( int argc, char **argv ) {
 	printf( "========================================\n" );
 
 	// Initialize Program
+	THR_Init();
 	MEM_Init();
 
 	// Decide whether Scripted or Interactive
@@ -261,10 +301,13 @@ int	main( int argc, char **argv ) {
 		SKY_CmdLoop();
 
 	// Wait for things to finish...
-	
+	THR_Shutdown();
+
 	// Free Buffers and Close
 	printf( "Quit.\n" );
 	MEM_FreeAllBuffers();
+	PAIR_Free( &pairTable );
+	SIG_Free();
 	printf( "========================================" );
 	printf( "========================================\n" );
 	return EXIT_SUCCESS;
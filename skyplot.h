@@ -22,6 +22,7 @@
 * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 */
 #include <stdlib.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
@@ -39,6 +40,7 @@
 */
 // Program-specific
 #define	PROJECTNAME		"skyplot"
+#define	SKY_CMD_LEN		1024	// command line, room for 64 bin edges
 
 // Calculation constants
 #define	MOLLWEIDE_ERROR		0.0000001
@@ -49,6 +51,80 @@
 
 // Data input
 #define	NVSS_LINE_LEN		145
+#define	NVSS_RA_COL		0	// hh mm ss.ss
+#define	NVSS_DEC_COL		21	// +dd mm ss.s
+#define	NVSS_GAL_COL		44	// galactic longitude, latitude
+#define	NVSS_FLUX_COL		60	// Stokes I flux density (mJy)
+#define	NVSS_FLUX_LEN		10	// width of the flux field
+#define	NVSS_RM_COL		125	// RM and its error (rad/m^2)
+#define	SDSS_FILE		"./data/SDSS_galaxies.dat"
+#define	COMOVD_FILE		"./data/comovD.dat"
+#define	NVSS_FILE		"./data/RMCatalogue.txt"
+
+// Binary catalog cache
+#define	CACHE_MAGIC		"SKYCACHE"
+#define	CACHE_VERSION		2
+#define	CACHE_MAX_SOURCES	2	// source files per catalog
+#define	CACHE_PAGE		4096	// records start page aligned
+
+// NVSS-SDSS pair table
+#define	PAIR_MAGIC		"SKYPAIRS"
+#define	PAIR_VERSION		1
+#define	PAIR_FILE		"/dev/shm/skyplot/pairs.dat"
+#define	PAIR_DEFAULT_RADIUS	1000.0	// in Kpc
+
+// Columnar storage
+#define	CAT_ALIGN		64	// cache line alignment of columns
+
+// Multithreading
+#define	THR_PROGRESS_PERCENT	10	// progress line every 10 %
+#define	THR_MARK_HIT		1	// per source results of a job
+#define	THR_MARK_MISS		2
+
+// Cross-matching
+#define	XM_BAND_WIDTH		1.0	// declination band width in deg
+#define	XM_RADIUS_PAD		1e-9	// rounding margin in deg
+#define	XM_MAX_DISCPIX		64	// disc index size limit per galaxy
+#define	XM_IMPACT_PAD		1e-9	// relative rounding margin of impacts
+#define	XM_DEFAULT_NEAR		1000.0	// nearest galaxy search radius in Kpc
+
+// Spatial tree
+#define	KDT_DISC_EPSILON	1e-12	// squared chord margin of whole nodes
+
+// Sky pixelization
+#define	HPX_MAX_ORDER		13	// pixel indices must fit an int
+#define	HPX_MAX_MAPORDER	10	// largest order for per-pixel lists
+#define	HPX_DEFAULT_ORDER	6	// about 0.9 deg pixels
+
+// Two-sample tests
+#define	SIG_LABEL_LEN		32
+#define	SIG_KS_EXACT		10000	// exact KS below this n_A*n_B
+#define	SIG_KS_TOL		1e-6	// Kolmogorov series tolerance
+#define	SIG_DEFAULT_REPLICATES	1000
+#define	SIG_STREAM_PERM		0	// random streams of a replicate
+#define	SIG_STREAM_BOOT		1
+#define	SIG_STREAM_ROT		2
+#define	SIG_STREAM_RAND		3
+#define	SIG_HIST_BINS		20
+#define	SIG_HIST_WIDTH		50	// characters of the longest bar
+#define	SIG_JK_REGIONS		50	// default jackknife regions
+#define	SIG_JK_ORDER		5	// pixels of the regions, about 1.8 deg
+
+// Random catalogs
+#define	RND_DEFAULT_FACTOR	10.0	// random galaxies per galaxy
+#define	RND_REACH_PAD		0.01	// margin of the cap around a pixel
+
+// Rotation null
+#define	STAT_DEFAULT_ROTATIONS	64
+#define	STAT_ROT_MIN		10.0	// smallest RA offset in deg
+
+// Multi-bin division
+#define	STAT_MAX_BINS		64	// bits of a source's bin mask
+
+// Threshold sweep, in Kpc
+#define	STAT_SWEEP_MIN		10.0
+#define	STAT_SWEEP_MAX		1000.0
+#define	STAT_SWEEP_STEPS	50
 
 // Cosmological parameters
 #define	OMEGA_M			0.272
@@ -79,41 +155,275 @@ typedef struct catdata_s {
 
 	// Rotation Measure
 	double	rot_measure;
+	double	rot_measure_err;
+	double	flux;			// NVSS flux density in mJy
 	double	rot_measure_mean;	// mean RM in neighbourhood
 	double	rot_measure_delta;	// delta of RM to mean RM
 	int	sourcesNum;		// number of sources inside annulus
+	double	rot_measure_var;	// variance of the RM in neighbourhood
 	double	rot_measure_mean_nn;	// mean for Nearest neighbor
 	double	rot_measure_delta_nn;	// delta for NN
 	double	rot_measure_sd_nn;	// standard deviation with NN
 	double	rot_measure_median;
 	double	rot_measure_median_delta;
 
+	// nearest SDSS galaxy by impact parameter
+	double	near_impact;		// in Kpc
+	double	near_index;		// row of the full SDSS, -1 for none
+	double	near_z;
+	double	near_mass;
+	double	near_ubcolor;
+
 	double	comovD;		// in GPc
 	double	angDiamD;
 
 	double	mollw_angle;
 	double	mollw_angle_gal;
 	double	cosdec;			// cos(dec)
+	double	vec[3];			// Cartesian unit vector
 } catdata_t;
 
+// one column per catdata_t member
+typedef enum catfield_e {
+	CF_NONE = -1,
+	CF_RA,
+	CF_DEC,
+	CF_Z,
+	CF_ABSMAG,
+	CF_UBCOLOR,
+	CF_MASS,
+	CF_LONGITUDE,
+	CF_LATITUDE,
+	CF_RM,
+	CF_RMERR,
+	CF_FLUX,
+	// results of ma/mn/a, stored per selection
+	CF_RMMEAN,
+	CF_RMDELTA,
+	CF_SOURCESNUM,
+	CF_RMVAR,
+	CF_RMMEANNN,
+	CF_RMDELTANN,
+	CF_RMSDNN,
+	CF_RMMEDIAN,
+	CF_RMMEDIANDELTA,
+	CF_NEARIMPACT,
+	CF_NEARINDEX,
+	CF_NEARZ,
+	CF_NEARMASS,
+	CF_NEARUBCOLOR,
+	CF_COMOVD,
+	CF_ANGDIAMD,
+	CF_MOLLW,
+	CF_MOLLWGAL,
+	CF_COSDEC,
+	CF_VECX,
+	CF_VECY,
+	CF_VECZ,
+	CF_NUMFIELDS
+} catfield_t;
+
+#define	CF_LASTRESULT		CF_NEARUBCOLOR
+
+typedef struct catcols_s {
+	int		number;
+	double		*col[CF_NUMFIELDS];	// NULL until requested
+} catcols_t;
+
+// what the near_* results of a selection were computed against
+typedef struct catnear_s {
+	double		radius;		// impact parameter searched, 0 if none
+	const struct catalog_s *sdss;	// galaxies searched
+	unsigned int	serial;		// their serial at that time
+} catnear_t;
+
+// Full catalogs own their rows in data. Culled and divided catalogs
+// are selections: index lists rows of base, data is NULL and the
+// ma/mn results live in their own columns. A selection of all rows
+// needs no index.
 typedef struct catalog_s {
 	cattype_t	type;
 	int		number;
 	double		threshold; // for selected NVSS
 	catdata_t	*data;	// pointer size may vary (32/64 bits)
+	struct catalog_s *base;	// full catalog of a selection
+	int		*index;	// selected rows of base, NULL for all rows
+	int		capacity; // room in index and result columns
+	catcols_t	*cols;	// columnar copy, built on demand
+	void		*map;	// read-only cache mapping holding data
+	size_t		mapSize;
+	unsigned int	serial;	// changes whenever the rows are cleared
+	catnear_t	near;
 } catalog_t;
 
+typedef struct cachesrc_s {
+	long long	size;
+	long long	mtime;
+} cachesrc_t;
+
+typedef struct cachehdr_s {
+	char		magic[8];	// CACHE_MAGIC
+	int		version;	// CACHE_VERSION
+	unsigned int	schema;		// MEM_SchemaHash() of the writer
+	int		type;
+	int		number;		// records
+	double		threshold;
+	int		recordSize;	// sizeof(catdata_t)
+	int		numFields;
+	int		fieldOffs[CF_NUMFIELDS];	// columns in a record
+	int		numSources;
+	cachesrc_t	source[CACHE_MAX_SOURCES];	// files it came from
+	long long	dataOffset;	// first record
+	long long	indexOffset;	// rows of the full catalog, or 0
+} cachehdr_t;
+
 typedef struct cullthread_s {
 	catalog_t	*from;
 	catalog_t	*toA;
 	catalog_t	*toB;
 
-	int		start;
-	int		end;
 	double		threshold;
 	time_t		tic;
+	unsigned char	*mark;		// per source result, 0 if not done
 } threadData_t;
 
+typedef struct thrrange_s {
+	pthread_mutex_t	lock;
+	int		next;		// next index to hand out
+	int		end;
+} thrrange_t;
+
+typedef struct thrjob_s {
+	// set by the caller
+	void		(*func)( void *arg, int start, int end, int worker );
+	void		(*finish)( void *arg );	// last worker, may be NULL
+	void		*arg;
+	int		number;		// indices [0,number) to work on
+	int		maxWorkers;	// 0 for the whole pool
+	int		grain;		// indices per chunk, 0 to choose
+
+	// owned by the pool
+	int		numWorkers;
+	int		chunk;
+	thrrange_t	*ranges;	// one per worker
+	int		running;	// workers not yet done
+	int		cancel;		// read and set atomically
+	int		done;
+	int		seq;		// 0 if never submitted
+	struct thrjob_s	*next;
+} thrjob_t;
+
+typedef struct xmatch_s {
+	catalog_t	*cat;		// SDSS catalog the index is built on
+	double		threshold;	// impact parameter threshold
+	int		number;
+	double		*cosReach;	// cos of each galaxy's reach
+	const double	*angDiamD;	// column of cat, not owned
+
+	// declination sweep, only built without the disc index
+	int		*order;		// catalog indices sorted by dec
+	double		*dec;		// sorted declinations
+	int		numBands;
+	int		*bandStart;	// first sorted entry of each band
+	double		*bandRadius;	// largest reachable radius in band
+	double		maxRadius;
+	double		*sx, *sy, *sz;	// unit vectors in sorted order
+	double		*scos;		// cosReach in sorted order
+
+	// reverse disc index, pixOrder is -1 if not built
+	int		pixOrder;
+	int		numPix;
+	int		*pixStart;	// first entry of each pixel
+	int		*pixGal;	// galaxies whose disc covers pixel
+	double		*px, *py, *pz;	// unit vectors of each entry
+	double		*pcos;		// cosReach of each entry
+} xmatch_t;
+
+typedef struct xmpair_s {
+	double		impact;		// impact parameter in Kpc
+	int		gal;		// SDSS galaxy
+} xmpair_t;
+
+// pairs of the full catalogs' rows, one row per NVSS source
+typedef struct pairtable_s {
+	double		radius;		// largest impact parameter, 0 if empty
+	int		numNVSS;	// rows of the full catalogs
+	int		numSDSS;
+	int		numPairs;
+	int		*start;		// first pair of each NVSS row
+	xmpair_t	*pairs;		// by impact parameter within a row
+	unsigned char	*nvssDone;	// rows the table was built for
+	unsigned char	*sdssDone;
+	void		*map;		// cache mapping holding the arrays
+	size_t		mapSize;
+} pairtable_t;
+
+typedef struct pairhdr_s {
+	char		magic[8];	// PAIR_MAGIC
+	int		version;	// PAIR_VERSION
+	double		radius;
+	int		numNVSS;
+	int		numSDSS;
+	int		numPairs;
+	int		numSources[2];	// NVSS, SDSS
+	cachesrc_t	source[2][CACHE_MAX_SOURCES];
+	long long	pairOffset;	// page aligned
+	long long	startOffset;
+	long long	nvssOffset;
+	long long	sdssOffset;
+} pairhdr_t;
+
+typedef struct sigrow_s {
+	char		label[SIG_LABEL_LEN];
+	char		dataType;	// export letter of the column
+	int		numA, numB;
+	double		ks, ad, mw;	// statistics
+	double		pKS, pAD, pMW;	// p-values
+} sigrow_t;
+
+typedef struct sigsort_s {
+	double		key;
+	int		index;
+} sigsort_t;
+
+// counter-based random stream (Philox4x32-10)
+typedef struct sigrng_s {
+	unsigned int	key[2];
+	unsigned int	ctr[4];
+	unsigned int	out[4];		// current block
+	int		used;		// words of out already drawn
+} sigrng_t;
+
+typedef struct hpxlist_s {
+	int		*pix;
+	int		num;
+	int		size;
+} hpxlist_t;
+
+typedef struct kdtree_s {
+	int		number;
+	double		*pos;		// unit vectors in tree order
+	int		*index;		// catalog index of each point
+	char		*dim;		// split coordinate of each node
+
+	// subtree aggregates, NULL until KDT_Aggregate
+	double		*box;		// bounding box of each subtree (min, max)
+	double		*value;		// value of each point
+	double		*sum;		// sum of the values in each subtree
+	double		*sum2;		// sum of the squared values
+} kdtree_t;
+
+typedef struct kdsum_s {
+	int		num;
+	double		sum;
+	double		sum2;
+} kdsum_t;
+
+typedef struct kdnn_s {
+	double		dist2;		// squared chord length
+	int		index;
+} kdnn_t;
+
 typedef struct sortNN_s {
 	double		dist;
 	double		rot_measure;
@@ -140,6 +450,18 @@ extern catalog_t	sdss_B;
 
 extern catalog_t	nvss_A;
 extern catalog_t	nvss_B;
+extern catalog_t	nvss_control;
+
+extern catalog_t	sdss_random;
+
+// sky pixelization order of the random catalogs
+extern int		hpx_order;
+
+// NVSS-SDSS pairs, empty until built or loaded
+extern pairtable_t	pairTable;
+
+// catdata_t member behind each column
+extern const size_t	catFieldOffs[CF_NUMFIELDS];
 
 /*
 * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -152,48 +474,172 @@ void		SKY_ScriptLoop( const char *fileName );
 void		SKY_CmdLoop( void );
 
 // compute.c
-int		COM_ImpLThreshold( catdata_t *cdn, catdata_t *cds,
-							double threshold );
+double		COM_CosImpact( double angDiamD, double threshold );
 void		COM_MeanRM( const char *cmdLine );
 void		COM_MeanRM_NN( const char *cmdLine );
 
+// crossmatch.c
+int		XM_Reaches( const catdata_t *gal, const double *vec,
+							double threshold );
+void		XM_Build( xmatch_t *xm, catalog_t *sdss, double threshold );
+int		XM_FirstMatch( const xmatch_t *xm, const catdata_t *cdn );
+int		XM_Nearest( const xmatch_t *xm, const catdata_t *cdn,
+							double *impact );
+int		XM_NearCovers( const catalog_t *nvss, const catalog_t *sdss,
+							double threshold );
+const catdata_t*	XM_NearRow( const catalog_t *nvss, const double *index,
+									int i );
+void		XM_NearMarks( catalog_t *nvss, double threshold,
+							unsigned char *mark );
+int		XM_Pairs( const xmatch_t *xm, const catdata_t *cdn,
+							xmpair_t *pairs );
+int		XM_NearestColumns( catalog_t *nvss, catalog_t *sdss,
+							double radius );
+void		XM_Annotate( const char *cmdLine );
+void		XM_Free( xmatch_t *xm );
+
 // culling.c
+int		CUL_CullBusy( void );
 int		CUL_CullCancel( const char *cmdLine );
 
 // fileio.c
-int		FIO_OpenDataFile( FILE **fp, const char *fs, catalog_t *cat );
-int		FIO_ReadCatFile( FILE *fp, catalog_t *cat );
 void		FIO_CloseFile( FILE *fp );
-void		FIO_ReadDistFile( FILE *fp, catalog_t *cat );
-
-int		FIO_FileToMemory( const char *name, catalog_t *cat );
-void		FIO_MemoryToFile( const char *name, catalog_t *cat );
+int		FIO_ParseDouble( const char **cur, const char *end, double *out );
+int		FIO_LoadSDSS( catalog_t *cat );
+int		FIO_LoadNVSS( catalog_t *cat );
+
+int		FIO_CacheToMemory( const char *name, catalog_t *cat,
+						const char **sources );
+int		FIO_CacheToSelection( const char *name, catalog_t *sel,
+						const char **sources );
+void		FIO_ReleaseCache( catalog_t *cat );
+int		FIO_MemoryToCache( const char *name, catalog_t *cat,
+						const char **sources );
+int		FIO_PairsToCache( const char *name, const pairtable_t *pt );
+int		FIO_CacheToPairs( const char *name, pairtable_t *pt );
+void		FIO_ReleasePairs( pairtable_t *pt );
 void		FIO_DataToFile( const char *name, double *data, int number );
 
 int		FIO_OpenScriptFile( const char *name );
 int		FIO_ReadScript( char *cmdLine, int length );
 void		FIO_CloseScriptFile( void );
 
+// healpix.c
+int		HPX_NumPix( int order );
+int		HPX_Loc2Pix( int order, double z, double phi, double sth );
+int		HPX_Vec2Pix( int order, const double *vec );
+void		HPX_Pix2Vec( int order, int pix, double *vec );
+double		HPX_MaxPixRad( int order );
+int		HPX_OrderForRadius( double radius );
+void		HPX_ListAppend( hpxlist_t *list, int value );
+void		HPX_QueryDisc( int order, const double *vec, double radius,
+							hpxlist_t *list );
+void		HPX_CatalogPix( int order, catalog_t *cat, int galactic,
+								int *pix );
+
+// kdtree.c
+void		KDT_Build( kdtree_t *tree, catalog_t *cat );
+int		KDT_Nearest( const kdtree_t *tree, const double *vec, int skip,
+						int k, kdnn_t *heap );
+void		KDT_Aggregate( kdtree_t *tree, const double *value );
+void		KDT_DiscSum( const kdtree_t *tree, const double *vec,
+					double cosRadius, int skip, kdsum_t *out );
+void		KDT_Free( kdtree_t *tree );
+
 // math.c
-double		MAT_GreatCircD(double dra, double ddec,
-				double cosdec1, double cosdec2);
 double		MAT_AngDiamD( double z, double comovD );
+void		MAT_UnitVector( double ra, double dec, double *vec );
+double		MAT_Dot( const double *a, const double *b );
+int		MAT_FirstDotAbove( const double *x, const double *y,
+				const double *z, const double *cosv,
+				int lo, int hi, const double *vec );
+double		MAT_ChordAngle( double chord2 );
 void		MAT_Mollweide( double dec, double *result );
 
 // memory.c
+unsigned int	MEM_SchemaHash( void );
+const char**	MEM_CatSources( cattype_t type );
+catdata_t*	MEM_AllocCatData( int n );
+void*		MEM_AllocAligned( size_t size );
+int		MEM_IsResult( catfield_t field );
+int		MEM_RowIndex( const catalog_t *sel, int i );
+const catdata_t*	MEM_Row( const catalog_t *cat, int i );
+double		MEM_RowValue( const catdata_t *cd, catfield_t field );
+double*		MEM_ResultColumn( catalog_t *cat, catfield_t field );
+void		MEM_Reserve( catalog_t *sel, int n );
+double*		MEM_Column( catalog_t *cat, catfield_t field );
+void		MEM_DropColumns( catalog_t *cat );
+void		MEM_ClearCat( catalog_t *cat );
+void		MEM_CopyRows( catalog_t *cat, catdata_t *rows );
+void		MEM_ReleaseCat( catalog_t *sel );
+void		MEM_InitSelection( catalog_t *base, catalog_t *sel );
+void		MEM_SelectAll( catalog_t *sel );
+int		MEM_GatherCat( catalog_t *old, catalog_t *new,
+				const unsigned char *mark, int value );
 void		MEM_AppendCat( catalog_t *old, catalog_t *new, int offs );
 void		MEM_SwitchSDSSBuffer( void );
 void		MEM_SwitchNVSSBuffer( void );
 void		MEM_LoadCulled( void );
 void		MEM_SaveCulled( void );
 void		MEM_ResetCulled( void );
+size_t		MEM_PrintCatUsage( const char *name, const catalog_t *cat );
+void		MEM_PrintUsage( void );
+void		MEM_SetPixelOrder( const char *cmdLine );
 void		MEM_Init( void );
+void		MEM_FreeDataBuffer( catalog_t *cat );
 void		MEM_FreeAllBuffers( void );
 
+// pairs.c
+void		PAIR_Free( pairtable_t *pt );
+int		PAIR_Marks( catalog_t *nvss, catalog_t *sdss, double threshold,
+						unsigned char *mark );
+void		PAIR_Command( const char *cmdLine );
+
+// random.c
+void		RND_SDSSRandom( const char *cmdLine );
+
+// significance.c
+double		SIG_KSTest( const double *a, int na, const double *b, int nb,
+								double *d );
+double		SIG_ADTest( const double *a, int na, const double *b, int nb,
+								double *a2 );
+double		SIG_MWTest( const double *a, int na, const double *b, int nb,
+								double *u );
+int		SIG_CompareDouble( const void *a, const void *b );
+double*		SIG_SortedAbs( const double *col, int *num );
+double*		SIG_Defined( const double *col, int *num );
+int*		SIG_SortOrderAbs( const double *col, int *num );
+double		SIG_StdDev( const double *x, int num );
+double		SIG_Quantile( const double *sorted, int num, double p );
+void		SIG_RngSeed( sigrng_t *rng, unsigned long long seed, int kind,
+							int replicate );
+unsigned int	SIG_RngNext( sigrng_t *rng );
+int		SIG_RngBelow( sigrng_t *rng, int n );
+void		SIG_Histogram( const char *title, const double *x, int num,
+								double mark );
+void		SIG_Resample( const char *cmdLine );
+void		SIG_Jackknife( const char *cmdLine );
+void		SIG_Command( const char *cmdLine );
+void		SIG_Free( void );
+
 // statistics.c
+catfield_t	STAT_FieldOf( char dataType );
+int		STAT_DivideBusy( void );
 int		STAT_DivideCancel( const char *cmdLine );
 void		STAT_WriteToDisk( const char *cmdLine );
 
+// threads.c
+int		THR_NumCPUs( void );
+void		THR_Init( void );
+void		THR_Shutdown( void );
+int		THR_NumWorkers( int maxWorkers );
+void		THR_Submit( thrjob_t *job );
+int		THR_Busy( thrjob_t *job );
+void		THR_Wait( thrjob_t *job );
+void		THR_Cancel( thrjob_t *job );
+void		THR_Run( thrjob_t *job );
+void		THR_Progress( int *completed, int num, int total, time_t tic );
+
 // visual.c
 void		VIS_DrawPlot( const char *buf );
 
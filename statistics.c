@@ -30,13 +30,60 @@
 * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 */
 
-pthread_mutex_t	div_mutex = PTHREAD_MUTEX_INITIALIZER;
 int		div_completed;
-int		numDivThreads = -1;
-int		divThreadsFin = 0;
-pthread_t	*dpThreads;
-threadData_t	*dThreadData;
+thrjob_t	divJob;
+threadData_t	divData;
+xmatch_t	divMatch;
+xmatch_t	rotMatch;
 
+// bins of the last dm
+unsigned long long *binMask;	// per NVSS source, bit per bin
+catalog_t	*binFrom;
+unsigned int	binSerial;
+int		binNumber;
+int		binCount;
+double		binThreshold;
+
+
+/*
+================
+STAT_FieldOf
+
+column behind an export data type letter
+================
+*/
+catfield_t	STAT_FieldOf( char dataType ) {
+
+	switch ( dataType ) {
+		case 'z':	return CF_Z;
+		case 'n':	return CF_SOURCESNUM;
+		case 'd':	return CF_RMDELTA;
+		case 'e':	return CF_RMDELTANN;
+		case 'f':	return CF_RMMEDIANDELTA;
+		case 'm':	return CF_MASS;
+		case 'u':	return CF_UBCOLOR;
+		case 'x':	return CF_RA;
+		case 'y':	return CF_DEC;
+		case 'a':	return CF_MOLLW;
+		case 'b':	return CF_MOLLWGAL;
+		case 'c':	return CF_RMMEAN;
+		case 'w':	return CF_RMVAR;
+		case 'g':	return CF_RMMEANNN;
+		case 'h':	return CF_RMSDNN;
+		case 'k':	return CF_LONGITUDE;
+		case 'l':	return CF_LATITUDE;
+		case 'r':	return CF_RM;
+		case 's':	return CF_RMERR;
+		case 'i':	return CF_FLUX;
+		// nearest galaxy
+		case 'p':	return CF_NEARIMPACT;
+		case 'j':	return CF_NEARINDEX;
+		case 'o':	return CF_NEARZ;
+		case 'q':	return CF_NEARMASS;
+		case 'v':	return CF_NEARUBCOLOR;
+		default:	return CF_NONE;
+	}
+}
 
 /*
 ================
@@ -46,13 +93,12 @@ Write data to disk for stat. analysis
 ================
 */
 void	STAT_WriteToDisk( const char *cmdLine ) {
-	int		i;
 	char		type;
 	char		subType;
 	char		dataType1;
 	catalog_t	*cat;
 	const char	*caption;
-	double		*data;
+	catfield_t	field;
 	char		fileName[64];
 	char		name[64];
 
@@ -97,160 +143,19 @@ void	STAT_WriteToDisk( const char *cmdLine ) {
 			return;
 	}
 
-	data = malloc( cat->number * sizeof(double) );
-
 	// what type of data
-	switch ( dataType1 ) {
-		case 'z':
-		for (i=0;i<cat->number; i++ ) {
-			catdata_t *cd;
-
-			cd = cat->data+i;
-			data[i] = cd->z;
-		}
-		break;
-		case 'n':
-		for (i=0;i<cat->number; i++ ) {
-			catdata_t *cd;
-
-			cd = cat->data+i;
-			data[i] = cd->sourcesNum;
-		}
-		break;
-		case 'd':
-		for (i=0;i<cat->number; i++ ) {
-			catdata_t *cd;
-
-			cd = cat->data+i;
-			data[i] = cd->rot_measure_delta;
-		}
-		break;
-		case 'e':
-		for (i=0;i<cat->number; i++ ) {
-			catdata_t *cd;
-
-			cd = cat->data+i;
-			data[i] = cd->rot_measure_delta_nn;
-		}
-		break;
-		case 'f':
-		for (i=0;i<cat->number; i++ ) {
-			catdata_t *cd;
-
-			cd = cat->data+i;
-			data[i] = cd->rot_measure_median_delta;
-		}
-		break;
-		case 'm':
-		for (i=0;i<cat->number; i++ ) {
-			catdata_t *cd;
-
-			cd = cat->data+i;
-			data[i] = cd->stellar_mass;
-		}
-		break;
-		case 'u':
-		for (i=0;i<cat->number; i++ ) {
-			catdata_t *cd;
-
-			cd = cat->data+i;
-			data[i] = cd->u_b_color;
-		}
-		break;
-		case 'x':
-		for (i=0;i<cat->number; i++ ) {
-			catdata_t *cd;
-
-			cd = cat->data+i;
-			data[i] = cd->ra;
-		}
-		break;
-		case 'y':
-		for (i=0;i<cat->number; i++ ) {
-			catdata_t *cd;
-
-			cd = cat->data+i;
-			data[i] = cd->dec;
-		}
-		break;
-		case 'a':
-		for (i=0;i<cat->number; i++ ) {
-			catdata_t *cd;
-
-			cd = cat->data+i;
-			data[i] = cd->mollw_angle;
-		}
-		break;
-		case 'b':
-		for (i=0;i<cat->number; i++ ) {
-			catdata_t *cd;
-
-			cd = cat->data+i;
-			data[i] = cd->mollw_angle_gal;
-		}
-		break;
-		case 'c':
-		for (i=0;i<cat->number; i++ ) {
-			catdata_t *cd;
-
-			cd = cat->data+i;
-			data[i] = cd->rot_measure_mean;
-		}
-		break;
-		case 'g':
-		for (i=0;i<cat->number; i++ ) {
-			catdata_t *cd;
-
-			cd = cat->data+i;
-			data[i] = cd->rot_measure_mean_nn;
-		}
-		break;
-		case 'h':
-		for (i=0;i<cat->number; i++ ) {
-			catdata_t *cd;
-
-			cd = cat->data+i;
-			data[i] = cd->rot_measure_sd_nn;
-		}
-		break;
-		case 'k':
-		for (i=0;i<cat->number; i++ ) {
-			catdata_t *cd;
-
-			cd = cat->data+i;
-			data[i] = cd->longitude;
-		}
-		break;
-		case 'l':
-		for (i=0;i<cat->number; i++ ) {
-			catdata_t *cd;
-
-			cd = cat->data+i;
-			data[i] = cd->latitude;
-		}
-		break;
-		case 'r':
-		for (i=0;i<cat->number; i++ ) {
-			catdata_t *cd;
-
-			cd = cat->data+i;
-			data[i] = cd->rot_measure;
-		}
-		break;
-		default:
-			printf( "Unrecognized data type '%c'.\n", type );
-			free( data );
-			return;
+	field = STAT_FieldOf( dataType1 );
+	if ( field == CF_NONE ) {
+		printf( "Unrecognized data type '%c'.\n", dataType1 );
+		return;
 	}
 
 	sprintf( fileName, "/dev/shm/skyplot/%s-%s.%c",
 					name, caption, dataType1 );
-	FIO_DataToFile( fileName, data, cat->number );
+	FIO_DataToFile( fileName, MEM_Column( cat, field ), cat->number );
 
 	printf( "Wrote %i lines of %c to %s.\n",
 				cat->number, dataType1, fileName );
-
-	free( data );
 }
 
 /*
@@ -265,6 +170,7 @@ void	STAT_DivideSDSS( const char *cmdLine ) {
 	char type;
 	double l, u;
 	catalog_t *sdss, *a, *b;
+	double *col, *col2;
 
 	// Scan selection parameters
 	sscanf( cmdLine, "%c %lf %lf", &type, &l, &u );
@@ -273,63 +179,62 @@ void	STAT_DivideSDSS( const char *cmdLine ) {
 	a = &sdss_A;
 	b = &sdss_B;
 
+	// after dg, A selects from the real galaxies again
+	if ( a->base != sdss->base ) {
+		MEM_FreeDataBuffer( a );
+		MEM_InitSelection( sdss->base, a );
+	}
+
 	// clear buffers
-	a->number = 0;
-	b->number = 0;
+	MEM_ClearCat( a );
+	MEM_ClearCat( b );
 
 	switch (type) {
 		case 't':
+		col = MEM_Column( sdss, CF_UBCOLOR );
+		col2 = MEM_Column( sdss, CF_MASS );
 		for ( i=0; i<sdss->number; i++ ) {
-			catdata_t *cd;
-
-			cd = sdss->data+i;
-			if ( cd->u_b_color >= 0.8 && cd->u_b_color <= 1.05
-			&& cd->stellar_mass >= 10 && cd->stellar_mass <= 11 )
+			if ( col[i] >= 0.8 && col[i] <= 1.05
+			&& col2[i] >= 10 && col2[i] <= 11 )
 				MEM_AppendCat( sdss, a, i );
 			else
 				MEM_AppendCat( sdss, b, i );
 		}
 		break;
 		case 'z':
+		col = MEM_Column( sdss, CF_Z );
 		for ( i=0; i<sdss->number; i++ ) {
-			catdata_t *cd;
-
-			cd = sdss->data+i;
-			if ( cd->z >= l && cd->z <= u)
+			if ( col[i] >= l && col[i] <= u)
 				MEM_AppendCat( sdss, a, i );
 			else
 				MEM_AppendCat( sdss, b, i );
 		}
 		break;
 		case 'c':
+		col = MEM_Column( sdss, CF_UBCOLOR );
 		for ( i=0; i<sdss->number; i++ ) {
-			catdata_t *cd;
-
-			cd = sdss->data+i;
-			if ( cd->u_b_color >= l && cd->u_b_color <= u)
+			if ( col[i] >= l && col[i] <= u)
 				MEM_AppendCat( sdss, a, i );
 			else
 				MEM_AppendCat( sdss, b, i );
 		}
 		break;
 		case 'm':
+		col = MEM_Column( sdss, CF_MASS );
 		for ( i=0; i<sdss->number; i++ ) {
-			catdata_t *cd;
-
-			cd = sdss->data+i;
-			if ( cd->stellar_mass >= l && cd->stellar_mass <= u)
+			if ( col[i] >= l && col[i] <= u)
 				MEM_AppendCat( sdss, a, i );
 			else
 				MEM_AppendCat( sdss, b, i );
 		}
 		break;
 		case 'f':
+		col = MEM_Column( sdss, CF_UBCOLOR );
+		col2 = MEM_Column( sdss, CF_MASS );
 		for ( i=0; i<sdss->number; i++ ) {
-			catdata_t *cd;
 			double ratio;
 
-			cd = sdss->data+i;
-			ratio = cd->u_b_color / cd->stellar_mass;
+			ratio = col[i] / col2[i];
 			if ( ratio >= l && ratio <= u)
 				MEM_AppendCat( sdss, a, i );
 			else
@@ -337,11 +242,9 @@ void	STAT_DivideSDSS( const char *cmdLine ) {
 		}
 		break;
 		case 'r':
+		col = MEM_Column( sdss, CF_RA );
 		for ( i=0; i<sdss->number; i++ ) {
-			catdata_t *cd;
-
-			cd = sdss->data+i;
-			if ( cd->ra >= l && cd->ra <= u)
+			if ( col[i] >= l && col[i] <= u)
 				MEM_AppendCat( sdss, a, i );
 			else
 				MEM_AppendCat( sdss, b, i );
@@ -359,24 +262,26 @@ void	STAT_DivideSDSS( const char *cmdLine ) {
 ================
 STAT_ThreadFinished
 
-Worker thread finished
+Last worker finished
 ================
 */
-void	STAT_ThreadFinished( void ) {
+void	STAT_ThreadFinished( void *arg ) {
+	threadData_t	*threadData;
 
-	pthread_mutex_lock( &div_mutex );
-	divThreadsFin++;
-	pthread_mutex_unlock( &div_mutex );
+	threadData = arg;
 
-	if ( divThreadsFin < numDivThreads + 1 )
-		return;
+	// no thread uses the cross-match index anymore
+	XM_Free( &divMatch );
 
-	// worker threads finished
-	if ( scripted == 0 ) {
-		// free only in interactive mode here
-		free( dpThreads );
-		free( dThreadData );
-	}
+	// collect both bins in catalog order
+	MEM_GatherCat( threadData->from, threadData->toA,
+					threadData->mark, THR_MARK_HIT );
+	MEM_GatherCat( threadData->from, threadData->toB,
+					threadData->mark, THR_MARK_MISS );
+	threadData->toA->near = threadData->from->near;
+	threadData->toB->near = threadData->from->near;
+	free( threadData->mark );
+	threadData->mark = NULL;
 
 	printf( "Sorted %i sources to A and %i sources to B.\n",
 					nvss_A.number, nvss_B.number );
@@ -387,114 +292,63 @@ void	STAT_ThreadFinished( void ) {
 
 /*
 ================
-STAT_DivThread
+STAT_DivChunk
 
-Worker thread for dividing NVSS
+Worker job: divide the NVSS sources [start,end)
 ================
 */
-void*	STAT_DivThread( void *arg ) {
+void	STAT_DivChunk( void *arg, int start, int end, int worker ) {
 	threadData_t	*threadData;
-	int		i, k, j;
-	catalog_t	*from, *toA, *toB;
-	catalog_t	*sdss;
-	int		start;
-	int		end;
-	double		threshold;
-	time_t		tic;
-	time_t		toc;
-
-	// thread may be canceled any time
-	pthread_setcanceltype( PTHREAD_CANCEL_ASYNCHRONOUS, &i );
+	int		i;
+	catalog_t	*from;
 
 	// get our worker info
 	threadData = arg;
 
-	sdss = &sdss_A;
 	from = threadData->from;
-	toA = threadData->toA;
-	toB = threadData->toB;
-	start = threadData->start;
-	end = threadData->end;
-	threshold = threadData->threshold;
-	tic = threadData->tic;
 
-	j = 0;
-
-	// iterate
+	// iterate, every source is ours alone
 	for ( i=start; i<end; i++ ){
-		catdata_t	*cdn;
-		int		foundA = 0;
-
-		// print out info how far we got
-		if ( i%500 == 0 ) {
-			double difft;
-
-			pthread_mutex_lock( &div_mutex );
-			div_completed += i - start;
-			div_completed -= j;
-			j = i - start;
-			pthread_mutex_unlock( &div_mutex );
-
-			time( &toc );
-
-			difft = difftime(toc,tic);
-			printf( "%i%% time: %.1lf / %.1lf minutes\n",
-					100 * div_completed / from->number,
-					difft/60,
-					difft * from->number/div_completed/60 );
-		}
-
-		cdn = from->data + i;
-		// calculate distance to nearest SDSS
-		for ( k=0; k<sdss->number; k++ ) {
-			catdata_t *cds;
-			int result;
-
-			cds = sdss->data + k;
-			result = COM_ImpLThreshold( cdn, cds, threshold );
-
-			if ( result == 1 ) {
-				// found one nearby
-				pthread_mutex_lock( &div_mutex );
-				MEM_AppendCat( from, toA, i );
-				pthread_mutex_unlock( &div_mutex );
-				foundA = 1;
-				break;
-			}
-		}
-
-		if ( foundA == 0 ) {
-			pthread_mutex_lock( &div_mutex );
-			MEM_AppendCat( from, toB, i );
-			pthread_mutex_unlock( &div_mutex );
-		}
+		const catdata_t	*cdn;
+
+		cdn = MEM_Row( from, i );
+		// look for an SDSS galaxy of A within reach
+		if ( XM_FirstMatch( &divMatch, cdn ) >= 0 )
+			threadData->mark[i] = THR_MARK_HIT;
+		else
+			threadData->mark[i] = THR_MARK_MISS;
 	}
 
-	// Thread finished.
-	STAT_ThreadFinished();
-
-	return NULL;
+	THR_Progress( &div_completed, end-start, from->number, threadData->tic );
 }
 
 /*
 ================
 STAT_DivideNVSS
 
-Start threads to divide NVSS into A and B
+Hand the NVSS division into A and B to the thread pool
 ================
 */
 void	STAT_DivideNVSS( const char *cmdLine ) {
 	double			threshold;
-	int			i;
+	int			numThreads;
+	int			n;
 	catalog_t		*nvss;
 	catalog_t		*a, *b;
 
-	// Read division parameters
-	if ( sscanf( cmdLine, "%lf %i", &threshold, &numDivThreads ) != 2 ) {
-		threshold	= 20.0;
-		numDivThreads	= 2;
+	if ( THR_Busy( &divJob ) ) {
+		printf( "NVSS division still running.\n" );
+		return;
 	}
-	printf( "Dividing NVSS data (%i threads)...\n", numDivThreads );
+
+	// Read division parameters, all workers by default
+	n = sscanf( cmdLine, "%lf %i", &threshold, &numThreads );
+	if ( n < 1 )
+		threshold	= 20.0;
+	if ( n < 2 )
+		numThreads	= 0;
+	numThreads = THR_NumWorkers( numThreads );
+	printf( "Dividing NVSS data (%i threads)...\n", numThreads );
 	printf( "Threshold is %lf Kiloparsecs\n", threshold );
 
 	// a,b
@@ -505,97 +359,770 @@ void	STAT_DivideNVSS( const char *cmdLine ) {
 	// reset everything
 	a->threshold = threshold;
 	b->threshold = threshold;
-	a->number = 0;
-	b->number = 0;
+	MEM_ClearCat( a );
+	MEM_ClearCat( b );
 
 	div_completed = 0;
-	divThreadsFin = 0;
-
-	// allocate memory for thread management
-	dpThreads	= malloc( (numDivThreads+1) * sizeof(pthread_t) );
-	dThreadData	= malloc( (numDivThreads+1) * sizeof(threadData_t) );
-
-	// distribute the computation work among first n workers
-	for ( i=0; i<numDivThreads; i++ ){
-		(dThreadData+i)->start = i*(nvss->number/numDivThreads);
-		(dThreadData+i)->end = (i+1)*(nvss->number/numDivThreads);
-		(dThreadData+i)->threshold = threshold;
-		(dThreadData+i)->from = nvss;
-		(dThreadData+i)->toA = a;
-		(dThreadData+i)->toB = b;
-	}
-	// last worker gets the remainder
-	(dThreadData+numDivThreads)->start = nvss->number-(nvss->number%numDivThreads);
-	(dThreadData+numDivThreads)->end = nvss->number;
-	(dThreadData+numDivThreads)->threshold = threshold;
-	(dThreadData+numDivThreads)->from = nvss;
-	(dThreadData+numDivThreads)->toA = a;
-	(dThreadData+numDivThreads)->toB = b;
-
-	// let the workers begin
-	for ( i=0; i<=numDivThreads; i++ ){
-		int err;
 
-		// add a timestamp to measure working time
-		time(&(dThreadData+i)->tic);
+	divData.from = nvss;
+	divData.toA = a;
+	divData.toB = b;
+	divData.threshold = threshold;
+	divData.mark = calloc( nvss->number+1, 1 );
+	// add a timestamp to measure working time
+	time( &divData.tic );
+
+	// the nearest galaxies already tell
+	if ( XM_NearCovers( nvss, &sdss_A, threshold ) ) {
+		printf( "Using nearest galaxies up to %lf Kiloparsecs.\n",
+							nvss->near.radius );
+		XM_NearMarks( nvss, threshold, divData.mark );
+		STAT_ThreadFinished( &divData );
+		return;
+	}
+	// or a join with the pair table
+	if ( PAIR_Marks( nvss, &sdss_A, threshold, divData.mark ) ) {
+		STAT_ThreadFinished( &divData );
+		return;
+	}
 
-		err = pthread_create( dpThreads+i, NULL,
-					STAT_DivThread, dThreadData+i );
+	// sort the SDSS A bin by declination once for all workers
+	XM_Build( &divMatch, &sdss_A, threshold );
 
-		if ( err != 0 )
-			printf( "Error creating thread %i of %i.\n",
-					i, numDivThreads );
-	}
+	// let the workers begin
+	divJob.func = STAT_DivChunk;
+	divJob.finish = STAT_ThreadFinished;
+	divJob.arg = &divData;
+	divJob.number = nvss->number;
+	divJob.maxWorkers = numThreads;
+	THR_Submit( &divJob );
 }
 
 /*
 ================
 STAT_CancelNVSS
 
-Stop NVSS culling
+Stop NVSS dividing
 ================
 */
 void	STAT_CancelNVSS( void ) {
-	int i;
 
-	if ( divThreadsFin == numDivThreads + 1 ) {
+	if ( THR_Busy( &divJob ) == 0 ) {
 		printf( "Threads already finished.\n" );
 		return;
 	}
 
 	printf( "Stopping threads...\n" );
-	for ( i=0; i<numDivThreads; i++ ){
-		int err;
+	THR_Cancel( &divJob );
 
-		err = pthread_cancel( *(dpThreads+i) );
-		if ( err != 0 )
-			printf( "Error stopping thread %i of %i.\n",
-					i+1, numDivThreads );
+	printf( "done.\n" );
+}
+
+typedef struct rotjob_s {
+	catalog_t		*from;
+	int			numRot;		// rotations of this batch
+	const double		*cosRot, *sinRot, *rot;
+	unsigned long long	*mask;		// per source, bit per rotation
+	int			completed;
+	int			total;		// sources times batches
+	time_t			tic;
+} rotjob_t;
+
+/*
+================
+STAT_RotateChunk
+
+Worker job: match the sources [start,end) against SDSS A once for
+every rotation of the batch
+================
+*/
+void	STAT_RotateChunk( void *arg, int start, int end, int worker ) {
+	rotjob_t	*job;
+	int		i;
+
+	job = arg;
+	for ( i=start; i<end; i++ ) {
+		catdata_t		cd;
+		unsigned long long	m;
+		double			x, y, ra;
+		int			k;
+
+		cd = *MEM_Row( job->from, i );
+		x = cd.vec[0];
+		y = cd.vec[1];
+		ra = cd.ra;
+		m = 0;
+		for ( k=0; k<job->numRot; k++ ) {
+			// the sky turned by rot[k] in RA
+			cd.vec[0] = x*job->cosRot[k] - y*job->sinRot[k];
+			cd.vec[1] = x*job->sinRot[k] + y*job->cosRot[k];
+			cd.ra = ra + job->rot[k];
+			if ( cd.ra >= 360 )
+				cd.ra -= 360;
+			if ( XM_FirstMatch( &rotMatch, &cd ) >= 0 )
+				m |= 1ull << k;
+		}
+		job->mask[i] = m;
 	}
-	// wait for the last thread
-	pthread_join( *(dpThreads+numDivThreads), NULL );
 
-	printf( "done.\n" );
+	THR_Progress( &job->completed, end-start, job->total, job->tic );
 }
 
 /*
 ================
-STAT_WaitForThreads
+STAT_RotationNull
 
-Wait for the dividing threads to finish
+Redo the NVSS division against SDSS A with the NVSS turned in RA by
+random offsets: 'dr<x> [threshold] [rotations] [seed]'. The first
+rotation is 0, the real split. Up to 64 rotations share one pass
+over the sources.
 ================
 */
-void	STAT_WaitForThreads( void ) {
-	int i;
+void	STAT_RotationNull( const char *cmdLine ) {
+	char		dataType;
+	catfield_t	field;
+	double		threshold;
+	int		numRot;
+	unsigned long long seed;
+	catalog_t	*nvss;
+	double		*col;
+	double		*rot, *cosRot, *sinRot;
+	double		*sumA, *sumB, *diff;
+	int		*countA;
+	rotjob_t	job;
+	thrjob_t	thrJob;
+	sigrng_t	rng;
+	int		i, k, first, above, numDefined;
+	double		mean, sd;
+
+	dataType = cmdLine[0];
+	field = STAT_FieldOf( dataType );
+	if ( field == CF_NONE ) {
+		printf( "Unrecognized data type '%c'.\n", dataType );
+		return;
+	}
+	threshold = nvss_A.threshold > 0 ? nvss_A.threshold : 20.0;
+	numRot = STAT_DEFAULT_ROTATIONS;
+	seed = 1;
+	sscanf( cmdLine+1, "%lf %i %llu", &threshold, &numRot, &seed );
+	if ( numRot < 2 ) {
+		printf( "Need at least two rotations.\n" );
+		return;
+	}
+	if ( THR_Busy( &divJob ) ) {
+		printf( "NVSS division still running.\n" );
+		return;
+	}
+
+	nvss = nvss_culled;
+	printf( "Rotation null of %c, %i rotations, threshold %lf Kpc\n",
+						dataType, numRot, threshold );
+
+	// offsets away from the real sky, the first one is the real sky
+	rot = malloc( numRot * sizeof(double) );
+	cosRot = malloc( numRot * sizeof(double) );
+	sinRot = malloc( numRot * sizeof(double) );
+	SIG_RngSeed( &rng, seed, SIG_STREAM_ROT, 0 );
+	rot[0] = 0;
+	for ( k=1; k<numRot; k++ )
+		rot[k] = STAT_ROT_MIN + (360 - 2*STAT_ROT_MIN)
+				* (SIG_RngNext( &rng ) / 4294967296.0);
+	for ( k=0; k<numRot; k++ ) {
+		cosRot[k] = cos( RAD*rot[k] );
+		sinRot[k] = sin( RAD*rot[k] );
+	}
+
+	// spatial index of SDSS A for all rotations
+	XM_Build( &rotMatch, &sdss_A, threshold );
+	col = MEM_Column( nvss, field );
+	numDefined = 0;
+	for ( i=0; i<nvss->number; i++ )
+		if ( !isnan( col[i] ) )
+			numDefined++;
+
+	memset( &job, 0, sizeof(rotjob_t) );
+	job.from = nvss;
+	job.mask = malloc( (nvss->number+1) * sizeof(unsigned long long) );
+	job.total = nvss->number * ((numRot + 63) / 64);
+	time( &job.tic );
+
+	countA = calloc( numRot, sizeof(int) );
+	sumA = calloc( numRot, sizeof(double) );
+	sumB = calloc( numRot, sizeof(double) );
+	for ( first=0; first<numRot; first+=64 ) {
+		job.numRot = numRot - first < 64 ? numRot - first : 64;
+		job.rot = rot + first;
+		job.cosRot = cosRot + first;
+		job.sinRot = sinRot + first;
+
+		memset( &thrJob, 0, sizeof(thrjob_t) );
+		thrJob.func = STAT_RotateChunk;
+		thrJob.arg = &job;
+		thrJob.number = nvss->number;
+		THR_Run( &thrJob );
+
+		// sums in catalog order, whatever the workers did
+		for ( i=0; i<nvss->number; i++ ) {
+			if ( isnan( col[i] ) )
+				continue;
+			for ( k=0; k<job.numRot; k++ )
+				if ( job.mask[i] >> k & 1 ) {
+					countA[first+k]++;
+					sumA[first+k] += fabs( col[i] );
+				}
+				else
+					sumB[first+k] += fabs( col[i] );
+		}
+	}
+	printf( "\n" );
+	XM_Free( &rotMatch );
+
+	printf( "%10s %8s %8s %12s %12s %12s\n", "rotation", "A", "B",
+			"mean |x| A", "mean |x| B", "A - B" );
+	diff = malloc( numRot * sizeof(double) );
+	for ( k=0; k<numRot; k++ ) {
+		int countB = numDefined - countA[k];
+
+		diff[k] = (countA[k] ? sumA[k] / countA[k] : 0)
+				- (countB ? sumB[k] / countB : 0);
+		printf( "%10.4lf %8i %8i %12.6lf %12.6lf %12.6lf\n", rot[k],
+			countA[k], countB,
+			countA[k] ? sumA[k] / countA[k] : 0,
+			countB ? sumB[k] / countB : 0, diff[k] );
+	}
+
+	// where the real sky falls among the rotated ones
+	above = 0;
+	mean = 0;
+	for ( k=1; k<numRot; k++ ) {
+		if ( diff[k] >= diff[0] )
+			above++;
+		mean += diff[k];
+	}
+	mean /= numRot - 1;
+	sd = SIG_StdDev( diff+1, numRot-1 );
+	printf( "rotated A - B: mean %lf, sd %lf\n", mean, sd );
+	printf( "real A - B %lf, z = %lf, rotation p = %lg\n", diff[0],
+			sd > 0 ? (diff[0] - mean) / sd : 0,
+			(above + 1.0) / numRot );
+
+	free( rot );
+	free( cosRot );
+	free( sinRot );
+	free( job.mask );
+	free( countA );
+	free( sumA );
+	free( sumB );
+	free( diff );
+}
+
+typedef struct sweepjob_s {
+	int		num;
+	double		*sortedAbs;	// |x| of all sources, sorted
+	const catdata_t	**src;		// the same sources
+	const catdata_t	**gal;		// their nearest galaxies, NULL if none
+	double		*grid;
+	int		*numA;		// per threshold
+	double		*sumA, *sumB;
+	double		*medA, *medB;
+	double		*ks;
+} sweepjob_t;
+
+/*
+================
+STAT_SweepChunk
 
-	// wait for all threads to finish
-	for ( i=0; i<numDivThreads+1; i++ ){
-		if ( pthread_join( *(dpThreads+i), NULL ) != 0 )
-			printf( "Error joining thread %i of %i.\n",
-							i, numDivThreads );
+Worker job: split statistics at the thresholds [start,end), one
+walk over the sorted sources each
+================
+*/
+void	STAT_SweepChunk( void *arg, int start, int end, int worker ) {
+	sweepjob_t	*job;
+	int		k;
+
+	job = arg;
+	for ( k=start; k<end; k++ ) {
+		double	t, d, sumA, sumB;
+		double	a1, a2, b1, b2;
+		int	i, na, nb, ca, cb;
+		unsigned char *hit;
+
+		// the dot product cut of the cross-match at this threshold
+		t = job->grid[k];
+		hit = malloc( job->num+1 );
+		na = 0;
+		for ( i=0; i<job->num; i++ ) {
+			hit[i] = job->gal[i] != NULL
+				&& XM_Reaches( job->gal[i], job->src[i]->vec, t );
+			na += hit[i];
+		}
+		nb = job->num - na;
+
+		d = 0;
+		sumA = sumB = 0;
+		a1 = a2 = b1 = b2 = 0;
+		ca = cb = 0;
+		for ( i=0; i<job->num; ) {
+			double	value;
+
+			// whole group of equal values at once
+			value = job->sortedAbs[i];
+			for ( ; i<job->num && job->sortedAbs[i] == value; i++ ) {
+				if ( hit[i] ) {
+					// middle ranks give the median
+					if ( ca == (na-1)/2 )
+						a1 = value;
+					if ( ca == na/2 )
+						a2 = value;
+					sumA += value;
+					ca++;
+				}
+				else {
+					if ( cb == (nb-1)/2 )
+						b1 = value;
+					if ( cb == nb/2 )
+						b2 = value;
+					sumB += value;
+					cb++;
+				}
+			}
+			if ( na > 0 && nb > 0
+				&& fabs( (double)ca/na - (double)cb/nb ) > d )
+				d = fabs( (double)ca/na - (double)cb/nb );
+		}
+		job->numA[k] = na;
+		job->sumA[k] = sumA;
+		job->sumB[k] = sumB;
+		job->medA[k] = (a1 + a2) / 2;
+		job->medB[k] = (b1 + b2) / 2;
+		job->ks[k] = d;
+		free( hit );
 	}
 }
 
+/*
+================
+STAT_ThresholdSweep
+
+The A/B split of column x for a grid of impact parameter
+thresholds: 'dt<x> [min] [max] [steps]', log spaced. One nearest
+galaxy search against SDSS A up to max serves all thresholds, and
+later dn up to max.
+================
+*/
+void	STAT_ThresholdSweep( const char *cmdLine ) {
+	char		dataType;
+	catfield_t	field;
+	double		lo, hi;
+	int		steps;
+	catalog_t	*nvss;
+	sweepjob_t	job;
+	thrjob_t	thrJob;
+	double		*col, *index;
+	int		*order;
+	int		i, k;
+
+	dataType = cmdLine[0];
+	field = STAT_FieldOf( dataType );
+	if ( field == CF_NONE ) {
+		printf( "Unrecognized data type '%c'.\n", dataType );
+		return;
+	}
+	lo = STAT_SWEEP_MIN;
+	hi = STAT_SWEEP_MAX;
+	steps = STAT_SWEEP_STEPS;
+	sscanf( cmdLine+1, "%lf %lf %i", &lo, &hi, &steps );
+	if ( lo <= 0 || hi < lo || steps < 1 ) {
+		printf( "Need 0 < min <= max and at least one step.\n" );
+		return;
+	}
+	if ( THR_Busy( &divJob ) || CUL_CullBusy() ) {
+		printf( "NVSS culling or division still running.\n" );
+		return;
+	}
+
+	nvss = nvss_culled;
+	printf( "Sweep of %c, %i thresholds from %lf to %lf Kpc\n",
+						dataType, steps, lo, hi );
+
+	// the nearest galaxy decides the split at every threshold
+	if ( XM_NearCovers( nvss, &sdss_A, hi ) )
+		printf( "Using nearest galaxies up to %lf Kiloparsecs.\n",
+							nvss->near.radius );
+	else
+		XM_NearestColumns( nvss, &sdss_A, hi );
+
+	memset( &job, 0, sizeof(sweepjob_t) );
+	job.grid = malloc( steps * sizeof(double) );
+	for ( k=0; k<steps; k++ )
+		job.grid[k] = steps > 1 ? lo * pow( hi/lo, (double)k/(steps-1) )
+									: lo;
+
+	// sources sorted by |x| once for all thresholds
+	col = MEM_Column( nvss, field );
+	index = MEM_Column( nvss, CF_NEARINDEX );
+	job.num = nvss->number;
+	order = SIG_SortOrderAbs( col, &job.num );
+	job.sortedAbs = malloc( (job.num+1) * sizeof(double) );
+	job.src = malloc( (job.num+1) * sizeof(catdata_t*) );
+	job.gal = malloc( (job.num+1) * sizeof(catdata_t*) );
+	for ( i=0; i<job.num; i++ ) {
+		job.sortedAbs[i] = fabs( col[order[i]] );
+		job.src[i] = MEM_Row( nvss, order[i] );
+		job.gal[i] = XM_NearRow( nvss, index, order[i] );
+	}
+	free( order );
+	job.numA = malloc( steps * sizeof(int) );
+	job.sumA = malloc( steps * sizeof(double) );
+	job.sumB = malloc( steps * sizeof(double) );
+	job.medA = malloc( steps * sizeof(double) );
+	job.medB = malloc( steps * sizeof(double) );
+	job.ks = malloc( steps * sizeof(double) );
+
+	memset( &thrJob, 0, sizeof(thrjob_t) );
+	thrJob.func = STAT_SweepChunk;
+	thrJob.arg = &job;
+	thrJob.number = steps;
+	thrJob.grain = 1;
+	THR_Run( &thrJob );
+
+	printf( "%12s %8s %8s %12s %12s %12s %12s %12s %9s\n", "threshold",
+			"A", "B", "mean |x| A", "mean |x| B", "A - B",
+			"median A", "median B", "KS D" );
+	for ( k=0; k<steps; k++ ) {
+		int	na, nb;
+		double	meanA, meanB;
+
+		na = job.numA[k];
+		nb = job.num - na;
+		meanA = na ? job.sumA[k] / na : 0;
+		meanB = nb ? job.sumB[k] / nb : 0;
+		printf( "%12.4lf %8i %8i %12.6lf %12.6lf %12.6lf %12.6lf "
+			"%12.6lf %9.6lf\n", job.grid[k], na, nb, meanA, meanB,
+			meanA - meanB, job.medA[k], job.medB[k], job.ks[k] );
+	}
+
+	free( job.grid );
+	free( job.sortedAbs );
+	free( job.src );
+	free( job.gal );
+	free( job.numA );
+	free( job.sumA );
+	free( job.sumB );
+	free( job.medA );
+	free( job.medB );
+	free( job.ks );
+}
+
+typedef struct binjob_s {
+	xmatch_t	xm;
+	catalog_t	*from;
+	const int	*galBin;	// bin of each indexed galaxy
+	unsigned long long *mask;	// per source, bit per bin
+	xmpair_t	**scratch;	// per worker
+	int		*scratchSize;
+	int		completed;
+	time_t		tic;
+} binjob_t;
+
+/*
+================
+STAT_BinChunk
+
+Worker job: bins with a galaxy in reach of the sources [start,end)
+================
+*/
+void	STAT_BinChunk( void *arg, int start, int end, int worker ) {
+	binjob_t	*job;
+	int		i;
+
+	job = arg;
+	for ( i=start; i<end; i++ ) {
+		const catdata_t		*cdn;
+		unsigned long long	m;
+		int			k, num;
+
+		cdn = MEM_Row( job->from, i );
+		num = XM_Pairs( &job->xm, cdn, NULL );
+		if ( num > job->scratchSize[worker] ) {
+			free( job->scratch[worker] );
+			job->scratchSize[worker] = 2*num;
+			job->scratch[worker] = malloc( 2*num * sizeof(xmpair_t) );
+		}
+		XM_Pairs( &job->xm, cdn, job->scratch[worker] );
+		m = 0;
+		for ( k=0; k<num; k++ )
+			m |= 1ull << job->galBin[job->scratch[worker][k].gal];
+		job->mask[i] = m;
+	}
+
+	THR_Progress( &job->completed, end-start, job->from->number, job->tic );
+}
+
+/*
+================
+STAT_MultiDivide
+
+Divide the culled SDSS into up to 64 bins of z, colour, mass or
+colour/mass ratio and find for every NVSS source the bins with a
+galaxy within the threshold, in one pass:
+'dm<z|c|m|f> <threshold> e <edge> <edge> ...' or
+'dm<z|c|m|f> <threshold> q <bins>' for equally populated bins.
+dk picks one bin as NVSS A afterwards.
+================
+*/
+void	STAT_MultiDivide( const char *cmdLine ) {
+	char		type, mode;
+	double		threshold;
+	double		*value, *sorted;
+	double		edges[STAT_MAX_BINS+1];
+	int		numEdges, numBins;
+	int		galCount[STAT_MAX_BINS], srcCount[STAT_MAX_BINS];
+	int		*galBin;
+	catalog_t	*sdss, *nvss;
+	catalog_t	binned;
+	binjob_t	job;
+	thrjob_t	thrJob;
+	const char	*p;
+	double		*col, *col2;
+	int		i, k, n, numWorkers, none;
+
+	if ( sscanf( cmdLine, "%c %lf %c%n", &type, &threshold, &mode, &n )
+									< 3 ) {
+		printf( "Usage: dm<z|c|m|f> <threshold> <e edges|q bins>\n" );
+		return;
+	}
+	if ( THR_Busy( &divJob ) || CUL_CullBusy() ) {
+		printf( "NVSS culling or division still running.\n" );
+		return;
+	}
+
+	sdss = sdss_culled;
+	nvss = nvss_culled;
+
+	// the property to bin by
+	value = malloc( (sdss->number+1) * sizeof(double) );
+	switch ( type ) {
+		case 'z':
+		memcpy( value, MEM_Column( sdss, CF_Z ),
+					sdss->number * sizeof(double) );
+		break;
+		case 'c':
+		memcpy( value, MEM_Column( sdss, CF_UBCOLOR ),
+					sdss->number * sizeof(double) );
+		break;
+		case 'm':
+		memcpy( value, MEM_Column( sdss, CF_MASS ),
+					sdss->number * sizeof(double) );
+		break;
+		case 'f':
+		col = MEM_Column( sdss, CF_UBCOLOR );
+		col2 = MEM_Column( sdss, CF_MASS );
+		for ( i=0; i<sdss->number; i++ )
+			value[i] = col[i] / col2[i];
+		break;
+		default:
+		printf( "Did not recognize SDSS property '%c'.\n", type );
+		free( value );
+		return;
+	}
+
+	// bin edges, given or at quantiles
+	numEdges = 0;
+	p = cmdLine + n;
+	if ( mode == 'e' ) {
+		char *end;
+
+		for ( ;; ) {
+			double e = strtod( p, &end );
+
+			if ( end == p )
+				break;
+			if ( numEdges == STAT_MAX_BINS+1 ) {
+				numEdges = 0;
+				break;
+			}
+			edges[numEdges++] = e;
+			p = end;
+		}
+		for ( k=1; k<numEdges; k++ )
+			if ( edges[k] <= edges[k-1] )
+				numEdges = 0;
+	}
+	else if ( mode == 'q' ) {
+		if ( sscanf( p, "%i", &numBins ) == 1 && numBins >= 1
+			&& numBins <= STAT_MAX_BINS && sdss->number > 0 ) {
+			sorted = malloc( sdss->number * sizeof(double) );
+			memcpy( sorted, value, sdss->number * sizeof(double) );
+			qsort( sorted, sdss->number, sizeof(double),
+							SIG_CompareDouble );
+			for ( k=0; k<=numBins; k++ )
+				edges[k] = SIG_Quantile( sorted, sdss->number,
+							(double)k/numBins );
+			free( sorted );
+			numEdges = numBins+1;
+		}
+	}
+	if ( numEdges < 2 ) {
+		printf( "Need 2 to %i ascending edges or 1 to %i bins.\n",
+					STAT_MAX_BINS+1, STAT_MAX_BINS );
+		free( value );
+		return;
+	}
+	numBins = numEdges - 1;
+
+	// galaxies in any bin, the last edge belongs to the last bin
+	MEM_InitSelection( sdss->base, &binned );
+	galBin = malloc( (sdss->number+1) * sizeof(int) );
+	memset( galCount, 0, sizeof(galCount) );
+	for ( i=0; i<sdss->number; i++ ) {
+		int lo, hi;
+
+		if ( value[i] < edges[0] || value[i] > edges[numBins] )
+			continue;
+		lo = 0;
+		hi = numBins;
+		while ( hi - lo > 1 ) {
+			int mid = (lo + hi) / 2;
+
+			if ( value[i] < edges[mid] )
+				hi = mid;
+			else
+				lo = mid;
+		}
+		galBin[binned.number] = lo;
+		galCount[lo]++;
+		MEM_AppendCat( sdss, &binned, i );
+	}
+	free( value );
+
+	printf( "Dividing NVSS into %i bins of %c, threshold %lf Kpc...\n",
+						numBins, type, threshold );
+
+	// one cross-match with all binned galaxies
+	memset( &job, 0, sizeof(binjob_t) );
+	XM_Build( &job.xm, &binned, threshold );
+	job.from = nvss;
+	job.galBin = galBin;
+	free( binMask );
+	binMask = malloc( (nvss->number+1) * sizeof(unsigned long long) );
+	job.mask = binMask;
+	numWorkers = THR_NumWorkers( 0 );
+	job.scratch = calloc( numWorkers, sizeof(xmpair_t*) );
+	job.scratchSize = calloc( numWorkers, sizeof(int) );
+	time( &job.tic );
+
+	memset( &thrJob, 0, sizeof(thrjob_t) );
+	thrJob.func = STAT_BinChunk;
+	thrJob.arg = &job;
+	thrJob.number = nvss->number;
+	THR_Run( &thrJob );
+	printf( "\n" );
+
+	XM_Free( &job.xm );
+	for ( i=0; i<numWorkers; i++ )
+		free( job.scratch[i] );
+	free( job.scratch );
+	free( job.scratchSize );
+	free( galBin );
+	MEM_FreeDataBuffer( &binned );
+
+	// remember for dk
+	binFrom = nvss;
+	binSerial = nvss->serial;
+	binNumber = nvss->number;
+	binCount = numBins;
+	binThreshold = threshold;
+
+	memset( srcCount, 0, sizeof(srcCount) );
+	none = 0;
+	for ( i=0; i<nvss->number; i++ ) {
+		if ( binMask[i] == 0 )
+			none++;
+		for ( k=0; k<numBins; k++ )
+			srcCount[k] += binMask[i] >> k & 1;
+	}
+	printf( "%5s %12s %12s %9s %9s\n", "bin", "from", "to",
+						"galaxies", "NVSS" );
+	for ( k=0; k<numBins; k++ )
+		printf( "%5i %12.6lf %12.6lf %9i %9i\n", k, edges[k],
+				edges[k+1], galCount[k], srcCount[k] );
+	printf( "%i NVSS sources have no binned galaxy in reach.\n", none );
+}
+
+/*
+================
+STAT_SelectBin
+
+NVSS A gets the sources with a galaxy of one bin of the last dm,
+NVSS B those without a galaxy of that bin, as dn splits: 'dk <bin>'.
+'dk <bin> x' leaves the sources with a galaxy of another bin out of
+B, so B holds only sources without a binned galaxy in reach.
+================
+*/
+void	STAT_SelectBin( const char *cmdLine ) {
+	catalog_t	*nvss;
+	unsigned char	*mark;
+	int		bin, i;
+	char		option;
+
+	option = 0;
+	if ( sscanf( cmdLine, "%i %c", &bin, &option ) < 1 || bin < 0
+						|| bin >= binCount ) {
+		printf( "Need a bin from 0 to %i.\n", binCount-1 );
+		return;
+	}
+	if ( option != 0 && option != 'x' ) {
+		printf( "Unknown dk option '%c'.\n", option );
+		return;
+	}
+	nvss = nvss_culled;
+	if ( binMask == NULL || binFrom != nvss || binSerial != nvss->serial
+					|| binNumber != nvss->number ) {
+		printf( "The NVSS changed, run dm again.\n" );
+		return;
+	}
+	if ( THR_Busy( &divJob ) ) {
+		printf( "NVSS division still running.\n" );
+		return;
+	}
+
+	mark = malloc( nvss->number+1 );
+	for ( i=0; i<nvss->number; i++ )
+		if ( binMask[i] >> bin & 1 )
+			mark[i] = THR_MARK_HIT;
+		else if ( option == 'x' && binMask[i] != 0 )
+			mark[i] = 0;
+		else
+			mark[i] = THR_MARK_MISS;
+
+	MEM_ClearCat( &nvss_A );
+	MEM_ClearCat( &nvss_B );
+	nvss_A.threshold = binThreshold;
+	nvss_B.threshold = binThreshold;
+	MEM_GatherCat( nvss, &nvss_A, mark, THR_MARK_HIT );
+	MEM_GatherCat( nvss, &nvss_B, mark, THR_MARK_MISS );
+	nvss_A.near = nvss->near;
+	nvss_B.near = nvss->near;
+	free( mark );
+
+	printf( "Bin %i: %i sources to A and %i without a galaxy %s to B.\n",
+			bin, nvss_A.number, nvss_B.number,
+			option == 'x' ? "of any bin" : "of this bin" );
+}
+
+/*
+================
+STAT_DivideBusy
+
+1 while the NVSS division is running
+================
+*/
+int	STAT_DivideBusy( void ) {
+
+	return THR_Busy( &divJob );
+}
+
 /*
 ================
 STAT_DivideCancel
@@ -617,12 +1144,24 @@ int	STAT_DivideCancel( const char *cmdLine ) {
 		if ( scripted == 0 )
 			// no separating line...
 			return 1;
-		else {
-			STAT_WaitForThreads();
-			free( dpThreads );
-			free( dThreadData );
-		}
+		else
+			THR_Wait( &divJob );
 	}
+	else if ( subcommand == 'm' )
+		// NVSS by galaxies of many SDSS bins
+		STAT_MultiDivide( cmdLine+1 );
+	else if ( subcommand == 'k' )
+		// one of those bins as A
+		STAT_SelectBin( cmdLine+1 );
+	else if ( subcommand == 't' )
+		// A/B split over a threshold grid
+		STAT_ThresholdSweep( cmdLine+1 );
+	else if ( subcommand == 'g' )
+		// random galaxies as SDSS A
+		RND_SDSSRandom( cmdLine+1 );
+	else if ( subcommand == 'r' )
+		// rotated NVSS against SDSS A
+		STAT_RotationNull( cmdLine+1 );
 	else if ( subcommand == 'c' )
 		// Cancel NVSS culling
 		STAT_CancelNVSS();
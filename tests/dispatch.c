@@ -0,0 +1,112 @@
+/*
+* dispatch.c - every export data type reaches the two-sample test
+*
+* Copyright (C) 2012 Michael Rieder <mr@student.ethz.ch>
+*
+* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or (at
+* your option) any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+*
+* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*/
+
+#include "../skyplot.h"
+
+#define	TEST_SOURCES		20
+
+// normally in skyplot.c
+int			scripted;
+
+extern sigrow_t		*sigTable;
+extern int		sigRows;
+
+/*
+================
+TEST_Fake
+
+small NVSS with A and B both selecting every source
+================
+*/
+void	TEST_Fake( void ) {
+	int i;
+
+	nvss_full.type = CT_NVSS;
+	nvss_full.number = TEST_SOURCES;
+	nvss_full.data = MEM_AllocCatData( TEST_SOURCES );
+	for ( i=0; i<TEST_SOURCES; i++ ) {
+		nvss_full.data[i].ra = i;
+		nvss_full.data[i].rot_measure = i - TEST_SOURCES/2;
+	}
+	MEM_InitSelection( &nvss_full, &nvss_A );
+	MEM_InitSelection( &nvss_full, &nvss_B );
+	MEM_SelectAll( &nvss_A );
+	MEM_SelectAll( &nvss_B );
+}
+
+/*
+================
+main
+
+each letter STAT_FieldOf knows must add a row to the test table,
+the table commands must not be taken for a data type
+================
+*/
+int	main( int argc, char **argv ) {
+	char		cmd[4];
+	int		c;
+	int		letters, failed;
+
+	TEST_Fake();
+
+	// the tests talk a lot
+	if ( freopen( "/dev/null", "w", stdout ) == NULL )
+		return EXIT_FAILURE;
+
+	letters = 0;
+	failed = 0;
+	for ( c=0; c<128; c++ ) {
+		int rows;
+
+		if ( STAT_FieldOf( c ) == CF_NONE )
+			continue;
+		letters++;
+		rows = sigRows;
+		snprintf( cmd, sizeof(cmd), "%c\n", c );
+		SIG_Command( cmd );
+		if ( sigRows != rows+1 || sigTable[rows].dataType != c ) {
+			fprintf( stderr, "t%c did not run a test.\n", c );
+			failed++;
+		}
+	}
+
+	if ( STAT_FieldOf( 't' ) != CF_NONE ) {
+		fprintf( stderr, "'t' is taken by the test table commands.\n" );
+		failed++;
+	}
+	SIG_Command( "tp\n" );
+	if ( sigRows != letters ) {
+		fprintf( stderr, "ttp changed the table.\n" );
+		failed++;
+	}
+	SIG_Command( "tw\n" );
+	if ( sigRows != 0 ) {
+		fprintf( stderr, "ttw did not wipe the table.\n" );
+		failed++;
+	}
+
+	fprintf( stderr, "SIG_Command: %i of %i data types not dispatched.\n",
+						failed, letters );
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,137 @@
+/*
+* dotabove.c - SIMD against scalar dot product decisions
+*
+* Copyright (C) 2012 Michael Rieder <mr@student.ethz.ch>
+*
+* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or (at
+* your option) any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+*
+* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*/
+
+#include "../skyplot.h"
+
+#define	TEST_MAX_LEN		64	// longest column range tried
+#define	TEST_ROUNDS		2000	// random vector sets per range
+
+/*
+================
+TEST_RandomUnit
+
+random unit vector, uniform on the sphere
+================
+*/
+void	TEST_RandomUnit( double *vec ) {
+
+	MAT_UnitVector( 360.0*drand48(), DEG*asin( 2.0*drand48()-1.0 ), vec );
+}
+
+/*
+================
+TEST_FirstScalar
+
+reference decision: first entry whose MAT_Dot exceeds its threshold
+================
+*/
+int	TEST_FirstScalar( const double *x, const double *y, const double *z,
+			const double *cosv, int lo, int hi, const double *vec ) {
+	int i;
+
+	for ( i=lo; i<hi; i++ ) {
+		double p[3];
+
+		p[0] = x[i];
+		p[1] = y[i];
+		p[2] = z[i];
+		if ( MAT_Dot( p, vec ) > cosv[i] )
+			return i;
+	}
+	return -1;
+}
+
+/*
+================
+TEST_Range
+
+one random set of columns over [lo,hi). Thresholds are exact ties
+(rejected), one ulp below the dot product (accepted) or random.
+Returns the number of mismatches.
+================
+*/
+int	TEST_Range( int lo, int hi ) {
+	double	x[TEST_MAX_LEN], y[TEST_MAX_LEN], z[TEST_MAX_LEN];
+	double	cosv[TEST_MAX_LEN];
+	double	vec[3];
+	int	i;
+	int	accept;
+	int	expect, got;
+
+	TEST_RandomUnit( vec );
+	// at most one accepted entry, so every position gets tested
+	accept = lo + (int)(drand48() * (hi-lo+1));
+	for ( i=lo; i<hi; i++ ) {
+		double p[3];
+		double dot;
+
+		TEST_RandomUnit( p );
+		x[i] = p[0];
+		y[i] = p[1];
+		z[i] = p[2];
+		dot = MAT_Dot( p, vec );
+		if ( i == accept )
+			cosv[i] = nextafter( dot, -2.0 );
+		else if ( drand48() < 0.5 )
+			cosv[i] = dot;
+		else
+			cosv[i] = dot + drand48();
+	}
+
+	expect = TEST_FirstScalar( x, y, z, cosv, lo, hi, vec );
+	got = MAT_FirstDotAbove( x, y, z, cosv, lo, hi, vec );
+	if ( expect != got ) {
+		printf( "[%i,%i): scalar %i, MAT_FirstDotAbove %i\n",
+						lo, hi, expect, got );
+		return 1;
+	}
+	return 0;
+}
+
+/*
+================
+main
+
+every start offset and length up to TEST_MAX_LEN, so all remainders
+0-7 of the 4 and 8 wide kernels come up
+================
+*/
+int	main( int argc, char **argv ) {
+	int	lo, hi, r;
+	int	tests, failed;
+
+	srand48( 1 );
+	tests = 0;
+	failed = 0;
+	for ( lo=0; lo<8; lo++ )
+		for ( hi=lo; hi<=TEST_MAX_LEN; hi++ )
+			for ( r=0; r<TEST_ROUNDS; r++ ) {
+				failed += TEST_Range( lo, hi );
+				tests++;
+			}
+
+	printf( "MAT_FirstDotAbove: %i of %i ranges differ from MAT_Dot.\n",
+							failed, tests );
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
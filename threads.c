@@ -0,0 +1,481 @@
+/*
+* threads.c - persistent worker thread pool
+*
+* Copyright (C) 2012 Michael Rieder <mr@student.ethz.ch>
+*
+* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or (at
+* your option) any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+*
+* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*/
+
+#define _GNU_SOURCE
+#include <sched.h>
+#include <unistd.h>
+
+#include "skyplot.h"
+
+/*
+* Jobs are run one after the other. A job's index range is split
+* evenly among the workers taking part; a worker that runs out takes
+* chunks off the back half of the fullest remaining range.
+*/
+
+pthread_mutex_t	thr_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t	thr_wake = PTHREAD_COND_INITIALIZER;
+pthread_cond_t	thr_done = PTHREAD_COND_INITIALIZER;
+pthread_t	*thrWorkers;
+int		thrNumWorkers = 0;
+int		thrShutdown = 0;
+int		thrJobSeq = 0;
+thrjob_t	*thrQueue;		// current job first
+
+
+/*
+================
+THR_ReadQuota
+
+CPUs granted by a cgroup CPU quota, 0 if there is none
+================
+*/
+int	THR_ReadQuota( void ) {
+	FILE	*fp;
+	char	buf[64];
+	double	quota, period;
+
+	quota = -1;
+	period = 0;
+
+	// cgroup v2
+	fp = fopen( "/sys/fs/cgroup/cpu.max", "r" );
+	if ( fp != NULL ) {
+		if ( fgets( buf, sizeof(buf), fp ) != NULL
+			&& sscanf( buf, "%lf %lf", &quota, &period ) != 2 )
+			quota = -1;
+		fclose( fp );
+	}
+	else {
+		// cgroup v1
+		fp = fopen( "/sys/fs/cgroup/cpu/cpu.cfs_quota_us", "r" );
+		if ( fp != NULL ) {
+			if ( fscanf( fp, "%lf", &quota ) != 1 )
+				quota = -1;
+			fclose( fp );
+		}
+		fp = fopen( "/sys/fs/cgroup/cpu/cpu.cfs_period_us", "r" );
+		if ( fp != NULL ) {
+			if ( fscanf( fp, "%lf", &period ) != 1 )
+				period = 0;
+			fclose( fp );
+		}
+	}
+
+	if ( quota <= 0 || period <= 0 )
+		return 0;
+
+	return (int)ceil( quota / period );
+}
+
+/*
+================
+THR_NumCPUs
+
+number of CPUs this process may actually use
+================
+*/
+int	THR_NumCPUs( void ) {
+	int		n;
+	int		quota;
+	cpu_set_t	set;
+
+	n = (int)sysconf( _SC_NPROCESSORS_ONLN );
+
+	if ( sched_getaffinity( 0, sizeof(set), &set ) == 0
+			&& CPU_COUNT(&set) < n )
+		n = CPU_COUNT( &set );
+
+	quota = THR_ReadQuota();
+	if ( quota > 0 && quota < n )
+		n = quota;
+
+	if ( n < 1 )
+		n = 1;
+
+	return n;
+}
+
+/*
+================
+THR_TakeChunk
+
+Take the next chunk of a worker's own range, else steal the back
+half of the largest range left. Returns 0 if the job ran dry.
+================
+*/
+int	THR_TakeChunk( thrjob_t *job, int w, int *start, int *end ) {
+	thrrange_t	*own;
+	int		v, victim;
+	int		most;
+
+	own = job->ranges + w;
+	while ( 1 ) {
+		if ( __atomic_load_n( &job->cancel, __ATOMIC_RELAXED ) )
+			return 0;
+
+		pthread_mutex_lock( &own->lock );
+		if ( own->next < own->end ) {
+			*start = own->next;
+			*end = own->next + job->chunk;
+			if ( *end > own->end )
+				*end = own->end;
+			own->next = *end;
+			pthread_mutex_unlock( &own->lock );
+			return 1;
+		}
+		pthread_mutex_unlock( &own->lock );
+
+		// find someone to steal from
+		victim = -1;
+		most = 0;
+		for ( v=0; v<job->numWorkers; v++ ) {
+			int left;
+
+			pthread_mutex_lock( &job->ranges[v].lock );
+			left = job->ranges[v].end - job->ranges[v].next;
+			pthread_mutex_unlock( &job->ranges[v].lock );
+			if ( left > most ) {
+				most = left;
+				victim = v;
+			}
+		}
+		if ( victim < 0 )
+			return 0;
+
+		pthread_mutex_lock( &job->ranges[victim].lock );
+		{
+			thrrange_t	*r;
+			int		left, mid;
+
+			r = job->ranges + victim;
+			left = r->end - r->next;
+			if ( left <= 0 ) {
+				// somebody was faster, look again
+				pthread_mutex_unlock( &r->lock );
+				continue;
+			}
+			if ( left <= job->chunk ) {
+				// too small to split, take it all
+				*start = r->next;
+				*end = r->end;
+				r->next = r->end;
+				pthread_mutex_unlock( &r->lock );
+				return 1;
+			}
+			mid = r->next + left/2;
+			*start = mid;
+			*end = r->end;
+			r->end = mid;
+			pthread_mutex_unlock( &r->lock );
+		}
+
+		// never hold two range locks at once. Our range is empty,
+		// so nobody else touches it meanwhile
+		pthread_mutex_lock( &own->lock );
+		own->next = *start;
+		own->end = *end;
+		pthread_mutex_unlock( &own->lock );
+	}
+}
+
+/*
+================
+THR_RunJob
+
+Work on a job until nothing is left
+================
+*/
+void	THR_RunJob( thrjob_t *job, int w ) {
+	int start, end;
+
+	while ( THR_TakeChunk( job, w, &start, &end ) == 1 )
+		job->func( job->arg, start, end, w );
+}
+
+/*
+================
+THR_JobFinished
+
+Called under the pool mutex by the last worker to leave a job
+================
+*/
+void	THR_JobFinished( thrjob_t *job ) {
+	int i;
+
+	pthread_mutex_unlock( &thr_mutex );
+	if ( job->finish != NULL )
+		job->finish( job->arg );
+	pthread_mutex_lock( &thr_mutex );
+
+	thrQueue = job->next;
+
+	for ( i=0; i<job->numWorkers; i++ )
+		pthread_mutex_destroy( &job->ranges[i].lock );
+	free( job->ranges );
+	job->ranges = NULL;
+	job->done = 1;
+
+	pthread_cond_broadcast( &thr_done );
+	// the next job may start
+	pthread_cond_broadcast( &thr_wake );
+}
+
+/*
+================
+THR_Worker
+
+Worker thread main loop
+================
+*/
+void*	THR_Worker( void *arg ) {
+	int	w;
+	int	lastSeq;
+
+	w = (int)(size_t)arg;
+	lastSeq = 0;
+
+	pthread_mutex_lock( &thr_mutex );
+	while ( 1 ) {
+		thrjob_t *job;
+
+		job = thrQueue;
+		if ( thrShutdown )
+			break;
+		if ( job == NULL || job->seq == lastSeq
+				|| w >= job->numWorkers ) {
+			pthread_cond_wait( &thr_wake, &thr_mutex );
+			continue;
+		}
+		lastSeq = job->seq;
+		pthread_mutex_unlock( &thr_mutex );
+
+		THR_RunJob( job, w );
+
+		pthread_mutex_lock( &thr_mutex );
+		if ( --job->running == 0 )
+			THR_JobFinished( job );
+	}
+	pthread_mutex_unlock( &thr_mutex );
+
+	return NULL;
+}
+
+/*
+================
+THR_Init
+
+Start the worker threads, one per usable CPU
+================
+*/
+void	THR_Init( void ) {
+	int i;
+
+	thrNumWorkers = THR_NumCPUs();
+	thrWorkers = malloc( thrNumWorkers * sizeof(pthread_t) );
+
+	for ( i=0; i<thrNumWorkers; i++ ) {
+		if ( pthread_create( thrWorkers+i, NULL, THR_Worker,
+						(void*)(size_t)i ) != 0 ) {
+			printf( "Error creating thread %i of %i.\n",
+						i+1, thrNumWorkers );
+			break;
+		}
+	}
+	thrNumWorkers = i;
+
+	printf( "Thread pool: %i workers.\n", thrNumWorkers );
+}
+
+/*
+================
+THR_Shutdown
+
+Stop the worker threads after the queued jobs
+================
+*/
+void	THR_Shutdown( void ) {
+	int i;
+
+	pthread_mutex_lock( &thr_mutex );
+	while ( thrQueue != NULL )
+		pthread_cond_wait( &thr_done, &thr_mutex );
+	thrShutdown = 1;
+	pthread_cond_broadcast( &thr_wake );
+	pthread_mutex_unlock( &thr_mutex );
+
+	for ( i=0; i<thrNumWorkers; i++ )
+		pthread_join( thrWorkers[i], NULL );
+
+	free( thrWorkers );
+	thrWorkers = NULL;
+	thrNumWorkers = 0;
+}
+
+/*
+================
+THR_NumWorkers
+
+workers a job asking for maxWorkers (0 for all) would get
+================
+*/
+int	THR_NumWorkers( int maxWorkers ) {
+
+	if ( maxWorkers <= 0 || maxWorkers > thrNumWorkers )
+		return thrNumWorkers;
+
+	return maxWorkers;
+}
+
+/*
+================
+THR_Submit
+
+Queue a job over [0,number). func, finish, arg, number, maxWorkers
+and grain have to be set; the job must stay valid until done.
+================
+*/
+void	THR_Submit( thrjob_t *job ) {
+	int		i;
+	thrjob_t	**last;
+
+	job->numWorkers = THR_NumWorkers( job->maxWorkers );
+	// small chunks near the end keep the workers together
+	job->chunk = job->number / (job->numWorkers * 64);
+	if ( job->chunk < 16 )
+		job->chunk = 16;
+	if ( job->grain > 0 )
+		job->chunk = job->grain;
+
+	job->ranges = malloc( job->numWorkers * sizeof(thrrange_t) );
+	for ( i=0; i<job->numWorkers; i++ ) {
+		pthread_mutex_init( &job->ranges[i].lock, NULL );
+		job->ranges[i].next = (int)((long)job->number * i
+							/ job->numWorkers);
+		job->ranges[i].end = (int)((long)job->number * (i+1)
+							/ job->numWorkers);
+	}
+
+	pthread_mutex_lock( &thr_mutex );
+	job->running = job->numWorkers;
+	job->cancel = 0;
+	job->done = 0;
+	job->seq = ++thrJobSeq;
+	job->next = NULL;
+
+	// append to the queue
+	for ( last=&thrQueue; *last!=NULL; last=&(*last)->next )
+		;
+	*last = job;
+
+	pthread_cond_broadcast( &thr_wake );
+	pthread_mutex_unlock( &thr_mutex );
+}
+
+/*
+================
+THR_Busy
+
+whether a submitted job has not finished yet
+================
+*/
+int	THR_Busy( thrjob_t *job ) {
+	int busy;
+
+	pthread_mutex_lock( &thr_mutex );
+	busy = job->seq != 0 && job->done == 0;
+	pthread_mutex_unlock( &thr_mutex );
+
+	return busy;
+}
+
+/*
+================
+THR_Wait
+
+Wait until a submitted job has finished
+================
+*/
+void	THR_Wait( thrjob_t *job ) {
+
+	pthread_mutex_lock( &thr_mutex );
+	while ( job->seq != 0 && job->done == 0 )
+		pthread_cond_wait( &thr_done, &thr_mutex );
+	pthread_mutex_unlock( &thr_mutex );
+}
+
+/*
+================
+THR_Cancel
+
+Stop handing out work of a job and wait for it to finish
+================
+*/
+void	THR_Cancel( thrjob_t *job ) {
+
+	__atomic_store_n( &job->cancel, 1, __ATOMIC_RELAXED );
+	THR_Wait( job );
+}
+
+/*
+================
+THR_Progress
+
+Count num more sources of total as done and print a progress
+line whenever another THR_PROGRESS_PERCENT are complete
+================
+*/
+void	THR_Progress( int *completed, int num, int total, time_t tic ) {
+	int	before, done;
+	time_t	toc;
+	double	difft;
+
+	before = __atomic_fetch_add( completed, num, __ATOMIC_RELAXED );
+	done = before + num;
+
+	if ( (long)done * 100 / THR_PROGRESS_PERCENT / total
+		== (long)before * 100 / THR_PROGRESS_PERCENT / total )
+		return;
+
+	time( &toc );
+
+	difft = difftime(toc,tic);
+	printf( "%i%% time: %.1lf / %.1lf minutes\n",
+			(int)(100.0 * done / total),
+			difft/60,
+			difft*total/done/60 );
+}
+
+/*
+================
+THR_Run
+
+Run a job and wait for it
+================
+*/
+void	THR_Run( thrjob_t *job ) {
+
+	THR_Submit( job );
+	THR_Wait( job );
+}
@@ -101,24 +101,28 @@ void	VIS_DrawPlot( const char *buf ) {
 	x = malloc( cat->number * sizeof(double) );
 	y = malloc( cat->number * sizeof(double) );
 
-	if ( galactic == 0 )
-		for (i=0;i<cat->number; i++ ) {
-			catdata_t *cd;
+	if ( galactic == 0 ) {
+		double *ra, *mollw;
 
-			cd = cat->data+i;
-			*(x+i) = -( cd->ra-180 ) * cos( cd->mollw_angle );
+		ra = MEM_Column( cat, CF_RA );
+		mollw = MEM_Column( cat, CF_MOLLW );
+		for (i=0;i<cat->number; i++ ) {
+			*(x+i) = -( ra[i]-180 ) * cos( mollw[i] );
 			//*(x+i) /= 90.0;
-			*(y+i) = 90*sin( cd->mollw_angle );
+			*(y+i) = 90*sin( mollw[i] );
 		}
-	else
-		for (i=0;i<cat->number; i++ ) {
-			catdata_t *cd;
+	}
+	else {
+		double *lon, *mollw;
 
-			cd = cat->data+i;
-			*(x+i) = -cd->longitude * cos( cd->mollw_angle_gal );
+		lon = MEM_Column( cat, CF_LONGITUDE );
+		mollw = MEM_Column( cat, CF_MOLLWGAL );
+		for (i=0;i<cat->number; i++ ) {
+			*(x+i) = -lon[i] * cos( mollw[i] );
 			//*(x+i) /= 90.0;
-			*(y+i) = 90*sin( cd->mollw_angle_gal );
+			*(y+i) = 90*sin( mollw[i] );
 		}
+	}
 
 	// Draw the Plot
 	VIS_PlotEllipse( plotCtrl );